@@ -0,0 +1,281 @@
+/* Microbenchmarks for the runway admission hand-off.
+ *
+ * Built and run by `make bench`.  runway.c is compiled into this file so
+ * the benchmarks drive the real enter/leave functions and controller
+ * threads.  Every aircraft has a runway time of zero and an effectively
+ * unlimited fuel reserve, so what is measured is the synchronization
+ * path: queueing, waking the controller, the grant and the wake-up of the
+ * aircraft, and the release.
+ *
+ * The simulation clock runs in virtual mode, so controller breaks and
+ * direction switches cost no wall-clock time; they still happen at least every
+ * controller-limit and direction-limit grants as in a real run.  All
+ * latencies below are wall-clock (CLOCK_MONOTONIC) times.
+ *
+ * Usage: runway-bench [--threads=N,N,...] [--ops=N] [--runways=N]
+ */
+
+#define main runway_main
+#include "runway.c"
+#undef main
+
+#define BENCH_OPS     10000      /* round trips per benchmark, all threads together */
+#define BENCH_FUEL    1000000    /* fuel reserve in seconds; never runs out */
+#define BENCH_LEVELS  16         /* most contention levels on the command line */
+#define BENCH_MIXED   -1         /* aircraft type of the mixed benchmark */
+
+typedef struct
+{
+  pthread_t tid;
+  int type;                 /* COMMERCIAL, CARGO, EMERGENCY or BENCH_MIXED */
+  int index;                /* thread number, varies the type when mixed */
+  long ops;
+  sample_vec round_trip;    /* ns from the enter call to the end of leave */
+  sample_vec grant;         /* ns from the enter call to being on the runway */
+} bench_thread;
+
+static int bench_next_id = 0;
+
+static long long bench_clock()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* One aircraft that requests the runway, leaves it straight away and
+ * comes back, ops times.
+ */
+static void *bench_aircraft(void *arg)
+{
+  bench_thread *bt = (bench_thread *)arg;
+  aircraft_info *ai = aircraft_alloc();
+  long long start, granted;
+  long i;
+
+  for (i = 0; i < bt->ops; i++)
+  {
+    ai->aircraft_type = bt->type == BENCH_MIXED ? (int)((bt->index + i) % 3) : bt->type;
+    ai->aircraft_id = __atomic_fetch_add(&bench_next_id, 1, __ATOMIC_RELAXED);
+    ai->runway_time = 0;
+    ai->fuel_reserve = (sim_time_t)BENCH_FUEL * NSEC_PER_SEC;
+    aircraft_reset(ai);
+    ai->times[LIFE_ARRIVAL] = sim_now();
+
+    start = bench_clock();
+    if (ai->aircraft_type == COMMERCIAL)
+    {
+      while (!commercial_enter(ai))
+        ;
+      granted = bench_clock();
+      commercial_leave(ai);
+    }
+    else if (ai->aircraft_type == CARGO)
+    {
+      while (!cargo_enter(ai))
+        ;
+      granted = bench_clock();
+      cargo_leave(ai);
+    }
+    else
+    {
+      while (!emergency_enter(ai))
+        ;
+      granted = bench_clock();
+      emergency_leave(ai);
+    }
+    sample_push(&bt->grant, granted - start);
+    sample_push(&bt->round_trip, bench_clock() - start);
+  }
+
+  aircraft_release(ai);
+  sim_thread_end();
+  return NULL;
+}
+
+/* Run ops round trips of aircraft type over nthreads aircraft against a
+ * fresh set of runways and controllers, and print one result line.
+ */
+static void bench_run(FILE *out, const char *name, int type, int nthreads, long ops)
+{
+  bench_thread *threads = calloc(nthreads, sizeof(*threads));
+  sample_vec round_trip = { NULL, 0, 0 };
+  sample_vec grant = { NULL, 0, 0 };
+  long long start, elapsed;
+  double sum = 0.0;
+  long j;
+  int i;
+  int result;
+
+  if (threads == NULL)
+  {
+    printf("runway-bench: out of memory\n");
+    exit(1);
+  }
+
+  runways_init();
+  __atomic_store_n(&controller_shutdown, 0, __ATOMIC_SEQ_CST);
+  for (i = 0; i < runway_count; i++)
+  {
+    sim_thread_begin();
+    result = pthread_create(&runways[i].controller_tid, NULL, controller_thread, &runways[i]);
+    if (result)
+    {
+      fprintf(out, "runway-bench: pthread_create failed for controller: %s\n", strerror(result));
+      exit(1);
+    }
+  }
+
+  start = bench_clock();
+  for (i = 0; i < nthreads; i++)
+  {
+    threads[i].type = type;
+    threads[i].index = i;
+    threads[i].ops = ops / nthreads + (i < ops % nthreads);
+    sim_thread_begin();
+    result = pthread_create(&threads[i].tid, NULL, bench_aircraft, &threads[i]);
+    if (result)
+    {
+      fprintf(out, "runway-bench: pthread_create failed for aircraft: %s\n", strerror(result));
+      exit(1);
+    }
+  }
+  for (i = 0; i < nthreads; i++)
+  {
+    pthread_join(threads[i].tid, NULL);
+  }
+  elapsed = bench_clock() - start;
+
+  __atomic_store_n(&controller_shutdown, 1, __ATOMIC_SEQ_CST);
+  for (i = 0; i < runway_count; i++)
+  {
+    pthread_mutex_lock(&runways[i].controller_mutex);
+    sim_cond_signal(&runways[i].controller_cond);
+    pthread_mutex_unlock(&runways[i].controller_mutex);
+  }
+  for (i = 0; i < runway_count; i++)
+  {
+    pthread_join(runways[i].controller_tid, NULL);
+  }
+  runways_destroy();
+
+  for (i = 0; i < nthreads; i++)
+  {
+    for (j = 0; j < threads[i].round_trip.count; j++)
+    {
+      sample_push(&round_trip, threads[i].round_trip.items[j]);
+      sample_push(&grant, threads[i].grant.items[j]);
+      sum += threads[i].round_trip.items[j];
+    }
+    free(threads[i].round_trip.items);
+    free(threads[i].grant.items);
+  }
+  qsort(round_trip.items, round_trip.count, sizeof(double), sample_compare);
+  qsort(grant.items, grant.count, sizeof(double), sample_compare);
+
+  fprintf(out, "%-12s %7d %10.0f %10.0f %10.0f %10.0f %10.0f %12.0f\n",
+          name, nthreads, round_trip.count ? sum / round_trip.count : 0.0,
+          sample_percentile(&round_trip, 0.50), sample_percentile(&round_trip, 0.99),
+          sample_percentile(&grant, 0.50), sample_percentile(&grant, 0.99),
+          elapsed ? (double)round_trip.count * NSEC_PER_SEC / elapsed : 0.0);
+  fflush(out);
+
+  free(round_trip.items);
+  free(grant.items);
+  free(threads);
+}
+
+int main(int nargs, char **args)
+{
+  static const char *names[4] = { "commercial", "cargo", "emergency", "mixed" };
+  static const int types[4] = { COMMERCIAL, CARGO, EMERGENCY, BENCH_MIXED };
+  int levels[BENCH_LEVELS] = { 1, 2, 4, 8, 16 };
+  int nlevels = 5;
+  long ops = BENCH_OPS;
+  char *p;
+  FILE *out;
+  int devnull;
+  int opt;
+  int i, k;
+  static const struct option long_options[] =
+  {
+    { "threads", required_argument, NULL, 't' },
+    { "ops",     required_argument, NULL, 'o' },
+    { "runways", required_argument, NULL, 'r' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  while ((opt = getopt_long(nargs, args, "", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 't':
+        nlevels = 0;
+        for (p = strtok(optarg, ","); p != NULL && nlevels < BENCH_LEVELS; p = strtok(NULL, ","))
+        {
+          if (parse_positive(p, &levels[nlevels]) != 0)
+          {
+            printf("runway-bench: --threads needs positive thread counts\n");
+            return EINVAL;
+          }
+          nlevels++;
+        }
+        break;
+      case 'o':
+        if (parse_positive_long(optarg, &ops) != 0)
+        {
+          printf("runway-bench: --ops needs a positive number of operations\n");
+          return EINVAL;
+        }
+        break;
+      case 'r':
+        if (parse_positive(optarg, &runway_count) != 0)
+        {
+          printf("runway-bench: --runways needs a positive number of runways\n");
+          return EINVAL;
+        }
+        break;
+      default:
+        printf("Usage: runway-bench [--threads=N,N,...] [--ops=N] [--runways=N]\n");
+        return EINVAL;
+    }
+  }
+
+  /* No event log, and anything else the simulator prints is dropped;
+   * only the results go to stdout.
+   */
+  log_mode = LOG_OFF;
+  out = fdopen(dup(STDOUT_FILENO), "w");
+  devnull = open("/dev/null", O_WRONLY);
+  if (out == NULL || devnull < 0)
+  {
+    printf("runway-bench: cannot set up output: %s\n", strerror(errno));
+    return 1;
+  }
+  dup2(devnull, STDOUT_FILENO);
+  close(devnull);
+
+  /* The main thread only starts and joins threads, it never waits on the
+   * simulation clock.
+   */
+  sim_clock_init(1);
+  sim_thread_end();
+
+  fprintf(out, "%ld round trips per benchmark, %d runway%s, runway time 0, latencies in ns\n\n",
+          ops, runway_count, runway_count > 1 ? "s" : "");
+  fprintf(out, "%-12s %7s %10s %10s %10s %10s %10s %12s\n",
+          "benchmark", "threads", "ns/op", "rt p50", "rt p99",
+          "grant p50", "grant p99", "grants/s");
+  for (k = 0; k < 4; k++)
+  {
+    for (i = 0; i < nlevels; i++)
+    {
+      bench_run(out, names[k], types[k], levels[i], ops);
+    }
+  }
+
+  aircraft_arena_destroy();
+  fclose(out);
+  return 0;
+}
@@ -19,6 +19,7 @@
 #define _GNU_SOURCE
 
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <unistd.h>
 #include <string.h>
@@ -27,801 +28,6587 @@
 #include <errno.h>
 #include <assert.h>
 #include <time.h>
+#include <limits.h>
+#include <math.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "runway_log.h"
+#include "runway_scenario.h"
+#include "runway_schedule.h"
+#include "runway_stats.h"
+
+/*** Lock profiling ***/
+
+/* Built with -DLOCK_PROFILE (make profile) every mutex and condition
+ * variable operation in this file goes through the profile_* functions
+ * near the end of it, which count them per named primitive and print a
+ * ranked report when the program exits.  The normal build is unchanged.
+ */
+#ifdef LOCK_PROFILE
+#include <stddef.h>
+
+static int profile_mutex_lock(pthread_mutex_t *m);
+static int profile_mutex_trylock(pthread_mutex_t *m);
+static int profile_mutex_unlock(pthread_mutex_t *m);
+static int profile_cond_wait(pthread_cond_t *c, pthread_mutex_t *m);
+static int profile_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m, const struct timespec *t);
+static void profile_wait_begin(const void *c, pthread_mutex_t *m, int kind);
+static void profile_wait_end(const void *c, pthread_mutex_t *m, int kind, int timed_out);
+static void profile_start();
+
+#define pthread_mutex_lock(m)            profile_mutex_lock(m)
+#define pthread_mutex_trylock(m)         profile_mutex_trylock(m)
+#define pthread_mutex_unlock(m)          profile_mutex_unlock(m)
+#define pthread_cond_wait(c, m)          profile_cond_wait(c, m)
+#define pthread_cond_timedwait(c, m, t)  profile_cond_timedwait(c, m, t)
+#else
+#define profile_wait_begin(c, m, kind)
+#define profile_wait_end(c, m, kind, timed_out)
+#define profile_start()
+#endif
+
+#define PROFILE_MUTEX    0
+#define PROFILE_COND     1       /* pthread_cond_t */
+#define PROFILE_SIM_COND 2       /* sim_cond_t */
 
 /*** Constants that define parameters of the simulation ***/
 
-#define MAX_RUNWAY_CAPACITY 2    /* Number of aircraft that can use runway simultaneously */
-#define CONTROLLER_LIMIT 8       /* Number of aircraft the controller can manage before break */
-#define MAX_AIRCRAFT 1000        /* Maximum number of aircraft in the simulation */
-#define FUEL_MIN 20              /* Minimum fuel reserve in seconds */
-#define FUEL_MAX 60              /* Maximum fuel reserve in seconds */
-#define EMERGENCY_TIMEOUT 30     /* Max wait time for emergency aircraft in seconds */
-#define DIRECTION_SWITCH_TIME 5  /* Time required to switch runway direction */
-#define DIRECTION_LIMIT 3        /* Max consecutive aircraft in same direction */
+/* The rules of the simulation are read at run time, so a what-if needs no
+ * rebuild: --set=NAME=VALUE changes one for a run and --sweep runs a grid
+ * of them.  The initializer below holds the defaults.
+ */
+typedef struct
+{
+  int max_runway_capacity;    /* Number of aircraft that can use runway simultaneously */
+  int controller_limit;       /* Number of aircraft the controller can manage before break */
+  int fuel_min;               /* Minimum fuel reserve in seconds */
+  int fuel_max;               /* Maximum fuel reserve in seconds */
+  int emergency_timeout;      /* Max wait time for emergency aircraft in seconds */
+  int direction_switch_time;  /* Time required to switch runway direction */
+  int direction_limit;        /* Max consecutive aircraft in same direction */
+  int break_time;             /* Length of a controller break in seconds */
+  int lookahead;              /* How far ahead the direction planner looks, 0 to react only */
+  int early_breaks;           /* Take breaks during switches and idle gaps, 0 only when due */
+  int backlog;                /* Waiting aircraft at which a stream input stops being read */
+} sim_config;
+
+static sim_config config = { 2, 8, 20, 60, 30, 5, 3, 5, 5, 1, 256 };
+
+/* Parameters by the name --set and --sweep know them by, with the range
+ * each can take.
+ */
+static const struct
+{
+  const char *name;
+  int *value;
+  int min, max;
+} config_params[] = {
+  { "capacity",          &config.max_runway_capacity,   1, 255 },
+  { "controller-limit",  &config.controller_limit,      1, INT_MAX },
+  { "direction-limit",   &config.direction_limit,       1, 0xffff },
+  { "switch-time",       &config.direction_switch_time, 0, INT_MAX },
+  { "break-time",        &config.break_time,            0, INT_MAX },
+  { "fuel-min",          &config.fuel_min,              1, INT_MAX },
+  { "fuel-max",          &config.fuel_max,              1, INT_MAX },
+  { "emergency-timeout", &config.emergency_timeout,     0, INT_MAX },
+  { "lookahead",         &config.lookahead,             0, INT_MAX },
+  { "early-breaks",      &config.early_breaks,          0, 1 },
+  { "backlog",           &config.backlog,               1, INT_MAX },
+};
+
+#define CONFIG_PARAMS (int)(sizeof(config_params) / sizeof(config_params[0]))
+
+/* Index of the parameter called name, or -1 after printing the names. */
+static int config_find(const char *name)
+{
+  int i;
+
+  for (i = 0; i < CONFIG_PARAMS; i++)
+    if (strcmp(config_params[i].name, name) == 0)
+      return i;
+  printf("runway: unknown parameter %s, known are:", name);
+  for (i = 0; i < CONFIG_PARAMS; i++)
+    printf(" %s", config_params[i].name);
+  printf("\n");
+  return -1;
+}
+
+/* Returns 0 if parameter i can take value, EINVAL after printing why not. */
+static int config_check_value(int i, int value)
+{
+  if (value < config_params[i].min || value > config_params[i].max)
+  {
+    printf("runway: %s must be between %d and %d\n",
+           config_params[i].name, config_params[i].min, config_params[i].max);
+    return EINVAL;
+  }
+  return 0;
+}
+
+/* Parse "NAME=VALUE" for --set.  Returns 0 on success or EINVAL. */
+static int config_set(char *arg)
+{
+  char *value = strchr(arg, '=');
+  char *end;
+  long v;
+  int i;
+
+  if (value == NULL)
+  {
+    printf("runway: --set needs NAME=VALUE\n");
+    return EINVAL;
+  }
+  *value++ = '\0';
+  if ((i = config_find(arg)) < 0)
+    return EINVAL;
+  v = strtol(value, &end, 10);
+  if (end == value || *end != '\0' || v < INT_MIN || v > INT_MAX)
+  {
+    printf("runway: --set=%s needs a number\n", arg);
+    return EINVAL;
+  }
+  if (config_check_value(i, (int)v) != 0)
+    return EINVAL;
+  *config_params[i].value = (int)v;
+  return 0;
+}
+
+/* Checks that need several parameters.  Returns 0 or EINVAL. */
+static int config_check()
+{
+  if (config.fuel_min > config.fuel_max)
+  {
+    printf("runway: fuel-min %d is above fuel-max %d\n", config.fuel_min, config.fuel_max);
+    return EINVAL;
+  }
+  return 0;
+}
+
+/* Parse a whole positive long like strtol() does for --set.  Returns 0
+ * and stores it in *out, or EINVAL if arg is anything else.
+ */
+static int parse_positive_long(const char *arg, long *out)
+{
+  char *end;
+  long v;
+
+  errno = 0;
+  v = strtol(arg, &end, 10);
+  if (end == arg || *end != '\0' || errno != 0 || v <= 0)
+    return EINVAL;
+  *out = v;
+  return 0;
+}
+
+/* The same for an int. */
+static int parse_positive(const char *arg, int *out)
+{
+  long v;
+
+  if (parse_positive_long(arg, &v) != 0 || v > INT_MAX)
+    return EINVAL;
+  *out = (int)v;
+  return 0;
+}
+
+#define AIRCRAFT_CHUNK 4096      /* Aircraft records per arena chunk */
 
 #define COMMERCIAL 0
 #define CARGO 1
 #define EMERGENCY 2
 
+#define HEAP_FUEL  0       /* aircraft_info.heap_index slot of fuel_heap */
+#define HEAP_QUEUE 1       /* aircraft_info.heap_index slot of wait_queue */
+#define HEAP_WATCHDOG 2    /* aircraft_info.heap_index slot of watchdog_heap */
+#define HEAP_URGENT 3      /* aircraft_info.heap_index slot of urgent_heap */
+#define HEAP_SLOTS 4
+
+/* Aircraft life cycle, see commercial_step() and friends */
+#define AIRCRAFT_ARRIVING       0  /* just created, not yet queued */
+#define AIRCRAFT_WAITING        1  /* in wait_queue until the controller grants the runway */
+#define AIRCRAFT_ON_RUNWAY      2  /* granted by the controller */
+#define AIRCRAFT_DEPARTING      3  /* runway time used up, about to leave */
+#define AIRCRAFT_CLEARED        4
+
+/* Lifecycle events timestamped in aircraft_info.times */
+#define LIFE_ARRIVAL  0    /* the aircraft starts running */
+#define LIFE_ENQUEUE  1    /* joins a wait queue */
+#define LIFE_GRANT    2    /* the controller grants it the runway */
+#define LIFE_RUNWAY   3    /* it starts its runway operations */
+#define LIFE_CLEAR    4    /* it has left the runway */
+#define LIFE_FUEL     5    /* it ran out of reserve fuel while waiting */
+#define LIFE_EVENTS   6
+#define LIFE_NONE     -1   /* event did not happen */
+
 #define NORTH 0
 #define SOUTH 1
 #define EAST  2
 #define WEST  4
 
-/* TODO */
-/* Add your synchronization variables here */
+/*** Simulation clock ***/
 
-/* basic information about simulation.  they are printed/checked at the end 
-* and in assert statements during execution.
-*
-* you are responsible for maintaining the integrity of these variables in the 
-* code that you develop. 
-*/
-pthread_mutex_t Mutex_ENTER = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_COM = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_CAR = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_EMER = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_COML = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_CARL = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_EMERL = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_WAITCOM = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_WAITCAR = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_FUEL_CAR = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t Mutex_FUEL_COM = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t Cond_COM = PTHREAD_COND_INITIALIZER;
-pthread_cond_t Cond_CAR = PTHREAD_COND_INITIALIZER;
-pthread_cond_t Cond_EMER = PTHREAD_COND_INITIALIZER;
-pthread_cond_t Cond_FUEL_CAR = PTHREAD_COND_INITIALIZER;
-pthread_cond_t Cond_FUEL_COM = PTHREAD_COND_INITIALIZER;
-
-int ready_COM;
-int ready_CAR;
-int ready_EMER;
-int ready_FUEL_COM;
-int ready_FUEL_CAR;
-int Commercial_Waiting;
-int Cargo_Waiting;
-int Emergency_Waiting;
-int Fuel_Waiting_COM;
-int Fuel_Waiting_CAR;
-int CAR_consecutive;
-int COM_consecutive;
-int Signal_COM;
-int Signal_CAR;
-int Fuel_COM;
-int Fuel_CAR;
-int Priority_COM;
-int Priority_CAR;
-int CAR_ticket;
-int COM_ticket;
-
-static int aircraft_on_runway = 0;       /* Total number of aircraft currently on runway */
-static int commercial_on_runway = 0;     /* Total number of commercial aircraft on runway */
-static int cargo_on_runway = 0;          /* Total number of cargo aircraft on runway */
-static int emergency_on_runway = 0;      /* Total number of emergency aircraft on runway */
-static int aircraft_since_break = 0;     /* Aircraft processed since last controller break */
-static int current_direction = NORTH;    /* Current runway direction (NORTH or SOUTH) */
-static int consecutive_direction = 0;    /* Consecutive aircraft in current direction */
-
-
-typedef struct 
-{
-  int arrival_time;         // time between the arrival of this aircraft and the previous aircraft
-  int runway_time;          // time the aircraft needs to spend on the runway
-  int aircraft_id;
-  int aircraft_type;        // COMMERCIAL, CARGO, or EMERGENCY
-  int fuel_reserve;         // Randomly assigned fuel reserve (FUEL_MIN to FUEL_MAX seconds)
-  time_t arrival_timestamp; // timestamp when aircraft thread was created
-} aircraft_info;
+/* Every timed or blocking wait in the simulator goes through the sim_*
+ * functions below.  In the default wall-clock mode they behave like
+ * nanosleep() and pthread_cond_wait().  With --virtual-time the clock only
+ * moves when every simulation thread is blocked, and then it jumps straight
+ * to the earliest pending wake-up, so a scenario runs as fast as its events
+ * can be executed while the admission rules stay exactly the same.
+ *
+ * The bookkeeping is a count of simulation threads that are not blocked in
+ * the clock (clock_running) plus a min-heap of timed waiters.  Whoever wakes
+ * a waiter counts it as running again before it is scheduled, so the clock
+ * can never advance past an event that is still being processed.
+ */
 
-/* Called at beginning of simulation.  
- * TODO: Create/initialize all synchronization
- * variables and other global variables that you add.
+#define NSEC_PER_SEC 1000000000LL
+#define SIM_FOREVER  LLONG_MAX
+
+typedef long long sim_time_t;     /* nanoseconds since simulation start */
+
+typedef struct sim_waiter
+{
+  struct sim_waiter *prev;        /* position on a sim_cond_t wait list */
+  struct sim_waiter *next;
+  struct sim_cond *list;          /* the wait list it is on, NULL if none */
+  pthread_cond_t cond;            /* the blocked thread sleeps on this */
+  sim_time_t deadline;            /* SIM_FOREVER if untimed */
+  int heap_index;                 /* slot in timer_heap, -1 if not queued */
+  int woken;
+  int timed_out;
+  void (*task)(void *arg);        /* pool task to resume instead of a thread */
+  void *task_arg;
+  struct sim_waiter *runq_next;   /* position on the worker pool run queue */
+} sim_waiter;
+
+/* Condition variable that is visible to the simulation clock.  The list is
+ * protected by Mutex_CLOCK, the predicate by the caller's own mutex.
  */
-static int initialize(aircraft_info *ai, char *filename) 
+typedef struct sim_cond
 {
-  aircraft_on_runway    = 0;
-  commercial_on_runway  = 0;
-  cargo_on_runway       = 0;
-  emergency_on_runway   = 0;
-  aircraft_since_break  = 0;
-  current_direction     = NORTH;
-  consecutive_direction = 0;
+  sim_waiter *head;
+  sim_waiter *tail;
+} sim_cond_t;
 
-  /* Initialize your synchronization variables (and 
-   * other variables you might use) here
-   */
+#define SIM_COND_INITIALIZER { NULL, NULL }
 
-  ready_CAR = 0;
-  ready_COM = 0;
-  ready_EMER = 0;
-  ready_FUEL_COM = 0;
-  ready_FUEL_CAR = 0;
-  Commercial_Waiting = 0;
-  Cargo_Waiting = 0;
-  Emergency_Waiting = 0;
-  Fuel_Waiting_CAR = 0;
-  Fuel_Waiting_COM = 0;
-  CAR_consecutive = 0;
-  COM_consecutive = 0;
-  Signal_CAR = 0;
-  Signal_COM = 0;
-  Fuel_COM = 0;
-  Fuel_CAR = 0;
-  Priority_COM = 2;
-  Priority_CAR = 2;
+static int virtual_time = 0;             /* set by --virtual-time */
+static pthread_mutex_t Mutex_CLOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_condattr_t clock_condattr;
+static struct timespec clock_epoch;      /* CLOCK_MONOTONIC at start (real mode) */
+static sim_time_t clock_now = 0;         /* current time (virtual mode) */
+static int clock_running = 1;            /* the main thread starts running */
+static sim_waiter **timer_heap = NULL;   /* min-heap on deadline: every timed
+                                            waiter in virtual mode, pool tasks
+                                            in real mode */
+static int timer_count = 0;
+static int timer_capacity = 0;
 
-  /* seed random number generator for fuel reserves */
-  srand(time(NULL));
+/* Worker pool (--pool).  Parked tasks are not threads and do not count in
+ * clock_running; a task that is woken goes on the run queue and an idle
+ * worker, which does count, is woken to run it.
+ */
+static sim_waiter *runq_head = NULL;
+static sim_waiter *runq_tail = NULL;
+static int pool_stopping = 0;
+static int pool_size = 0;
+static pthread_t *pool_tids = NULL;
+static pthread_t timer_tid;              /* fires task timers in real mode */
+static pthread_cond_t timer_thread_cond;
+static int timer_thread_running = 0;
 
-  /* Read in the data file and initialize the aircraft array */
-  FILE *fp;
+static void sim_clock_init(int use_virtual_time)
+{
+  virtual_time = use_virtual_time;
+  clock_now = 0;
+  clock_running = 1;
+  pthread_condattr_init(&clock_condattr);
+  pthread_condattr_setclock(&clock_condattr, CLOCK_MONOTONIC);
+  clock_gettime(CLOCK_MONOTONIC, &clock_epoch);
+}
+
+static sim_time_t timespec_to_sim(const struct timespec *ts)
+{
+  return (sim_time_t)(ts->tv_sec - clock_epoch.tv_sec) * NSEC_PER_SEC
+         + (ts->tv_nsec - clock_epoch.tv_nsec);
+}
+
+static struct timespec sim_to_timespec(sim_time_t t)
+{
+  struct timespec ts;
+  long long nsec = clock_epoch.tv_nsec + t % NSEC_PER_SEC;
+
+  ts.tv_sec = clock_epoch.tv_sec + (time_t)(t / NSEC_PER_SEC) + (time_t)(nsec / NSEC_PER_SEC);
+  ts.tv_nsec = (long)(nsec % NSEC_PER_SEC);
+  return ts;
+}
+
+/* Current simulation time in nanoseconds. */
+static sim_time_t sim_now()
+{
+  struct timespec ts;
+  sim_time_t now;
 
-  if((fp=fopen(filename, "r")) == NULL) 
+  if (virtual_time)
   {
-    printf("Cannot open input file %s for reading.\n", filename);
-    exit(1);
+    pthread_mutex_lock(&Mutex_CLOCK);
+    now = clock_now;
+    pthread_mutex_unlock(&Mutex_CLOCK);
+    return now;
   }
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return timespec_to_sim(&ts);
+}
+
+static void timer_swap(int a, int b)
+{
+  sim_waiter *w = timer_heap[a];
 
-  int i = 0;
-  char line[256];
-  while (fgets(line, sizeof(line), fp) && i < MAX_AIRCRAFT) 
+  timer_heap[a] = timer_heap[b];
+  timer_heap[b] = w;
+  timer_heap[a]->heap_index = a;
+  timer_heap[b]->heap_index = b;
+}
+
+static void timer_sift_up(int i)
+{
+  while (i > 0 && timer_heap[(i - 1) / 2]->deadline > timer_heap[i]->deadline)
   {
-    /* Skip comment lines and empty lines */
-    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
-      continue;
-    }
-    
-    /* Parse the line */
-    if (sscanf(line, "%d%d%d", &(ai[i].aircraft_type), &(ai[i].arrival_time), 
-               &(ai[i].runway_time)) == 3) {
-      /* Assign random fuel reserve between FUEL_MIN and FUEL_MAX */
-      ai[i].fuel_reserve = FUEL_MIN + (rand() % (FUEL_MAX - FUEL_MIN + 1));
-      i = i + 1;
+    timer_swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void timer_sift_down(int i)
+{
+  while (1)
+  {
+    int smallest = i;
+    int l = 2 * i + 1;
+    int r = 2 * i + 2;
+
+    if (l < timer_count && timer_heap[l]->deadline < timer_heap[smallest]->deadline)
+      smallest = l;
+    if (r < timer_count && timer_heap[r]->deadline < timer_heap[smallest]->deadline)
+      smallest = r;
+    if (smallest == i)
+      return;
+    timer_swap(i, smallest);
+    i = smallest;
+  }
+}
+
+/* Mutex_CLOCK must be held by the caller for all timer_* and *_locked calls. */
+static void timer_push(sim_waiter *w)
+{
+  if (timer_count == timer_capacity)
+  {
+    timer_capacity = timer_capacity ? timer_capacity * 2 : 64;
+    timer_heap = realloc(timer_heap, sizeof(*timer_heap) * timer_capacity);
+    if (timer_heap == NULL)
+    {
+      printf("runway: out of memory growing the timer heap\n");
+      exit(1);
     }
   }
+  w->heap_index = timer_count;
+  timer_heap[timer_count++] = w;
+  timer_sift_up(w->heap_index);
+}
 
-  fclose(fp);
-  return i;
+static void timer_remove(sim_waiter *w)
+{
+  int i = w->heap_index;
+
+  if (i < 0)
+    return;
+  w->heap_index = -1;
+  timer_count--;
+  if (i == timer_count)
+    return;
+  timer_heap[i] = timer_heap[timer_count];
+  timer_heap[i]->heap_index = i;
+  timer_sift_up(i);
+  timer_sift_down(timer_heap[i]->heap_index);
 }
 
-/* Code executed by controller to simulate taking a break 
- * You do not need to add anything here.  
+static void waitlist_remove(sim_waiter *w)
+{
+  sim_cond_t *c = w->list;
+
+  if (c == NULL)
+    return;
+  if (w->prev) w->prev->next = w->next; else c->head = w->next;
+  if (w->next) w->next->prev = w->prev; else c->tail = w->prev;
+  w->prev = w->next = NULL;
+  w->list = NULL;
+}
+
+static void waitlist_append(sim_cond_t *c, sim_waiter *w)
+{
+  w->list = c;
+  w->next = NULL;
+  w->prev = c->tail;
+  if (c->tail) c->tail->next = w; else c->head = w;
+  c->tail = w;
+}
+
+static void runq_push_locked(sim_waiter *w);
+
+static void waiter_wake_locked(sim_waiter *w)
+{
+  timer_remove(w);
+  waitlist_remove(w);
+  w->woken = 1;
+  if (w->task)
+  {
+    runq_push_locked(w);
+    return;
+  }
+  clock_running++;
+  pthread_cond_signal(&w->cond);
+}
+
+/* Jump the virtual clock to the earliest deadline and wake everything that
+ * is due at that instant.  Only called when no simulation thread can run.
  */
-__attribute__((unused)) static void take_break() 
+static void clock_advance_locked()
+{
+  if (timer_count == 0)
+    return;
+  if (timer_heap[0]->deadline > clock_now)
+    clock_now = timer_heap[0]->deadline;
+  while (timer_count > 0 && timer_heap[0]->deadline <= clock_now)
+  {
+    sim_waiter *w = timer_heap[0];
+
+    w->timed_out = 1;
+    waiter_wake_locked(w);
+  }
+}
+
+static void clock_block_locked()
 {
-  printf("The air traffic controller is taking a break now.\n");
-  sleep(5);
-  assert( aircraft_on_runway == 0 );
-  aircraft_since_break = 0;
+  clock_running--;
+  if (virtual_time && clock_running == 0)
+    clock_advance_locked();
 }
 
-/* Code executed to switch runway direction
- * You do not need to add anything here.
+/* Account for a thread that is about to join the simulation.  Must be
+ * called by the creating thread before pthread_create().
  */
-__attribute__((unused)) static void switch_direction()
+static void sim_thread_begin()
 {
-  printf("Switching runway direction from %s to %s\n",
-         current_direction == NORTH ? "NORTH" : "SOUTH",
-         current_direction == NORTH ? "SOUTH" : "NORTH");
-  
-  assert( aircraft_on_runway == 0 );  // Runway must be empty to switch
-  
-  sleep(DIRECTION_SWITCH_TIME);
-  
-  current_direction = (current_direction == NORTH) ? SOUTH : NORTH;
-  consecutive_direction = 0;
-  
-  printf("Runway direction switched to %s\n",
-         current_direction == NORTH ? "NORTH" : "SOUTH");
+  pthread_mutex_lock(&Mutex_CLOCK);
+  clock_running++;
+  pthread_mutex_unlock(&Mutex_CLOCK);
 }
 
-/* Code for the air traffic controller thread. This is fully implemented except for 
- * synchronization with the aircraft. See the comments within the function for details.
- *Function: controller_thread
- *Parameters: Controller_Thread_info - pointer to aircraft information structure
- *Returns: void
- *Description: This controls which aircrafts can go on to the runway.
- *             It checks to make sure that not too many are on the runway
- *             and checks for consecutiveness and for the controller to 
- *             take a break. When a aircraft can go on the runway, the aircraft gets signaled.
+/* Called by a thread that leaves the simulation, either for good or to
+ * block outside the clock (e.g. in pthread_join()).
  */
-void *controller_thread(void *arg) 
+static void sim_thread_end()
+{
+  pthread_mutex_lock(&Mutex_CLOCK);
+  clock_block_locked();
+  pthread_mutex_unlock(&Mutex_CLOCK);
+}
+
+static void waiter_init(sim_waiter *w, sim_time_t deadline)
 {
-  // Suppress the warning for now
- (void)arg;
+  w->prev = w->next = NULL;
+  w->list = NULL;
+  w->deadline = deadline;
+  w->heap_index = -1;
+  w->woken = 0;
+  w->timed_out = 0;
+  w->task = NULL;
+  w->task_arg = NULL;
+  w->runq_next = NULL;
+  pthread_cond_init(&w->cond, &clock_condattr);
+}
 
-  printf("The air traffic controller arrived and is beginning operations\n");
+/* Block the calling thread (Mutex_CLOCK held) until its waiter is woken by
+ * a signal or by its deadline passing.
+ */
+static void waiter_block_locked(sim_waiter *w)
+{
+  if (virtual_time && w->deadline != SIM_FOREVER)
+    timer_push(w);
+  clock_block_locked();
+  while (!w->woken)
+  {
+    if (!virtual_time && w->deadline != SIM_FOREVER)
+    {
+      struct timespec abstime = sim_to_timespec(w->deadline);
 
-  /* Loop while waiting for aircraft to arrive. */
-  while (1) 
-  {
-    /* TODO */
-    /* Add code here to handle aircraft requests, controller breaks,      */
-    /* and runway direction switches.                                     */
-    /* Currently the body of the loop is empty.  There's no communication */
-    /* between controller and aircraft, i.e. all aircraft are admitted    */
-    /* without regard for runway capacity, aircraft type, direction,      */
-    /* priorities, and whether the controller needs a break.              */
-    /* You need to add all of this.                                       */
-    if(consecutive_direction > DIRECTION_LIMIT && aircraft_on_runway == 0)
-    {
-      if(current_direction == SOUTH && Commercial_Waiting > 0)
-      {
-        switch_direction();
-      }
-      else if(current_direction == NORTH && Cargo_Waiting > 0)
-      {
-        switch_direction();
-      }
-      else
+      if (pthread_cond_timedwait(&w->cond, &Mutex_CLOCK, &abstime) == ETIMEDOUT && !w->woken)
       {
-        consecutive_direction = 2;
+        waitlist_remove(w);
+        w->timed_out = 1;
+        w->woken = 1;
+        clock_running++;
       }
     }
-    if(aircraft_since_break == CONTROLLER_LIMIT && aircraft_on_runway == 0)
+    else
     {
-      take_break();
-    }
-    if(aircraft_on_runway < MAX_RUNWAY_CAPACITY && aircraft_since_break < CONTROLLER_LIMIT 
-      && consecutive_direction <= DIRECTION_LIMIT)
-    {
-      if(Fuel_Waiting_CAR > 0 && commercial_on_runway == 0)
-      {
-        if(current_direction != SOUTH && aircraft_on_runway == 0 && Fuel_Waiting_COM == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == SOUTH)
-        {
-          pthread_mutex_lock(&Mutex_FUEL_CAR);
-          ready_FUEL_CAR = 1;
-          COM_consecutive = 0;
-          CAR_consecutive = 0;
-          pthread_cond_signal(&Cond_FUEL_CAR);
-          pthread_mutex_unlock(&Mutex_FUEL_CAR);
-        }
-      }
-      if(Fuel_Waiting_COM > 0 && cargo_on_runway == 0)
-      {
-        if(current_direction != NORTH && aircraft_on_runway == 0 && Fuel_Waiting_CAR == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == NORTH)
-        {
-          pthread_mutex_lock(&Mutex_FUEL_COM);
-          ready_FUEL_COM = 1;
-          COM_consecutive = 0;
-          CAR_consecutive = 0;
-          pthread_cond_signal(&Cond_FUEL_COM);
-          pthread_mutex_unlock(&Mutex_FUEL_COM);
-        }
-      }
-      if(COM_consecutive == 4 && Fuel_Waiting_CAR == 0 && Fuel_Waiting_COM == 0)
-      {
-        if(current_direction != SOUTH && aircraft_on_runway == 0 && Commercial_Waiting == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == SOUTH)
-        {
-          pthread_mutex_lock(&Mutex_CAR);
-          Signal_CAR = 1;
-          COM_consecutive = 0;
-          CAR_consecutive++;
-          ready_CAR = 1;
-          pthread_cond_signal(&Cond_CAR);
-          pthread_mutex_unlock(&Mutex_CAR);
-        }
-      }
-      if(CAR_consecutive == 4 && Fuel_Waiting_CAR == 0 && Fuel_Waiting_COM == 0)
-      {
-        if(current_direction != NORTH && aircraft_on_runway == 0 && Cargo_Waiting == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == NORTH)
-        {
-          pthread_mutex_lock(&Mutex_COM);
-          Signal_COM = 1;
-          COM_consecutive++;
-          CAR_consecutive = 0;
-          ready_COM = 1;
-          pthread_cond_signal(&Cond_COM);
-          pthread_mutex_unlock(&Mutex_COM);
-        }
-      }
-      if(Emergency_Waiting > 0 && Fuel_Waiting_CAR == 0 && Fuel_Waiting_COM == 0)
-      {
-        pthread_mutex_lock(&Mutex_EMER);
-        ready_EMER = 1;
-        COM_consecutive = 0;
-        CAR_consecutive = 0;
-        pthread_cond_signal(&Cond_EMER);
-        pthread_mutex_unlock(&Mutex_EMER);
-      }
-      if(cargo_on_runway == 0 && commercial_on_runway >= 0 && Commercial_Waiting > 0 && Emergency_Waiting
-         == 0 && Fuel_Waiting_CAR == 0 && Fuel_Waiting_COM == 0)
-      {
-        if(current_direction != NORTH && aircraft_on_runway == 0 && Cargo_Waiting == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == NORTH)
-        {
-          pthread_mutex_lock(&Mutex_COM);
-          Signal_COM = 1;
-          COM_consecutive++;
-          CAR_consecutive = 0;
-          ready_COM = 1;
-          pthread_cond_signal(&Cond_COM);
-          pthread_mutex_unlock(&Mutex_COM);
-        }
-      }
-      if(commercial_on_runway == 0 && cargo_on_runway >= 0 && Cargo_Waiting > 0 && 
-        Emergency_Waiting == 0 && Fuel_Waiting_CAR == 0 && Fuel_Waiting_COM == 0)
-      {
-        if(current_direction != SOUTH && aircraft_on_runway == 0 && Commercial_Waiting == 0)
-        {
-          switch_direction();
-        }
-        if(current_direction == SOUTH)
-        {
-          pthread_mutex_lock(&Mutex_CAR);
-          Signal_CAR = 1;
-          COM_consecutive = 0;
-          CAR_consecutive++;
-          ready_CAR = 1;
-          pthread_cond_signal(&Cond_CAR);
-          pthread_mutex_unlock(&Mutex_CAR);
-        }
-      }
+      pthread_cond_wait(&w->cond, &Mutex_CLOCK);
     }
+  }
+}
+
+/* Sleep for d nanoseconds of simulation time. */
+static void sim_sleep(sim_time_t d)
+{
+  sim_waiter w;
 
-    
-    /* Allow thread to be cancelled */
-    pthread_testcancel();
-    usleep(100000); // 100ms sleep to prevent busy waiting
+  if (!virtual_time)
+  {
+    struct timespec abstime = sim_to_timespec(sim_now() + d);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &abstime, NULL) == EINTR)
+      ;
+    return;
   }
-  pthread_exit(NULL);
+
+  pthread_mutex_lock(&Mutex_CLOCK);
+  waiter_init(&w, clock_now + d);
+  waiter_block_locked(&w);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+  pthread_cond_destroy(&w.cond);
 }
 
+/* Like pthread_cond_timedwait() with an absolute simulation-time deadline
+ * (SIM_FOREVER for none).  m must be held; it is released while blocked and
+ * re-acquired before returning.  Returns ETIMEDOUT if the deadline passed.
+ */
+static int sim_cond_timedwait(sim_cond_t *c, pthread_mutex_t *m, sim_time_t deadline)
+{
+  sim_waiter w;
 
-/* Code executed by a commercial aircraft to enter the runway.
- * You have to implement this.  Do not delete the assert() statements,
- * but feel free to add your own.
- * Function: commercial_enter
- * Parameters: aircraft_info - pointer to aircraft information structure.
- * Returns: void
- * Description: This function handles the control of commercial aircraft. They
- *              stay in a loop to check their fuel and when signaled will wait to
- *              get on the runway when signaled by the controller. When the aircraft
- *              is out of fuel it will print out a message and try to get priority.
+  profile_wait_begin(c, m, PROFILE_SIM_COND);
+  waiter_init(&w, deadline);
+  pthread_mutex_lock(&Mutex_CLOCK);
+  waitlist_append(c, &w);
+  pthread_mutex_unlock(m);
+  waiter_block_locked(&w);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+  pthread_cond_destroy(&w.cond);
+  pthread_mutex_lock(m);
+  profile_wait_end(c, m, PROFILE_SIM_COND, w.timed_out);
+  return w.timed_out ? ETIMEDOUT : 0;
+}
+
+static void sim_cond_wait(sim_cond_t *c, pthread_mutex_t *m)
+{
+  sim_cond_timedwait(c, m, SIM_FOREVER);
+}
+
+static void sim_cond_signal(sim_cond_t *c)
+{
+  pthread_mutex_lock(&Mutex_CLOCK);
+  if (c->head)
+  {
+    waiter_wake_locked(c->head);
+  }
+  pthread_mutex_unlock(&Mutex_CLOCK);
+}
+
+/*** Worker pool ***/
+
+/* Pool tasks run on a fixed set of worker threads.  A task never blocks:
+ * where a thread would wait it parks its sim_waiter on a sim_cond_t or on
+ * the timer heap and returns, and it is put back on the run queue when it
+ * is signalled or its timer fires.
  */
-void commercial_enter(aircraft_info *arg) 
+
+static sim_cond_t runq_idle_workers = SIM_COND_INITIALIZER;
+
+static void runq_push_locked(sim_waiter *w)
 {
-  // Suppress the compiler warning
-  (void)arg;
+  w->runq_next = NULL;
+  if (runq_tail) runq_tail->runq_next = w; else runq_head = w;
+  runq_tail = w;
+  if (runq_idle_workers.head)
+    waiter_wake_locked(runq_idle_workers.head);
+}
 
-  /* TODO */
-  /* Request permission to use the runway. You might also want to add      */
-  /* synchronization for the simulation variables below.                   */
-  /* Consider: runway capacity, direction (commercial prefer NORTH),       */
-  /* controller breaks, fuel levels, emergency priorities, and fairness.   */
-  /*  YOUR CODE HERE.                                                      */
-  pthread_mutex_lock(&Mutex_ENTER);
+/* Make a task runnable for the first time. */
+static void sim_spawn(sim_waiter *w, void (*task)(void *arg), void *arg)
+{
+  w->prev = w->next = NULL;
+  w->list = NULL;
+  w->heap_index = -1;
+  w->deadline = SIM_FOREVER;
+  w->task = task;
+  w->task_arg = arg;
+  pthread_mutex_lock(&Mutex_CLOCK);
+  runq_push_locked(w);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+}
 
-  Commercial_Waiting++;
+/* Park task w on c until it is signalled.  m must be held and is released. */
+static void sim_cond_park(sim_cond_t *c, pthread_mutex_t *m, sim_waiter *w)
+{
+  profile_wait_begin(c, m, PROFILE_SIM_COND);
+  pthread_mutex_lock(&Mutex_CLOCK);
+  w->woken = 0;
+  w->timed_out = 0;
+  w->deadline = SIM_FOREVER;
+  waitlist_append(c, w);
+  pthread_mutex_unlock(m);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+}
 
-  pthread_mutex_unlock(&Mutex_ENTER);
+/* Park task w for d nanoseconds of simulation time. */
+static void sim_sleep_park(sim_waiter *w, sim_time_t d)
+{
+  sim_time_t now = virtual_time ? 0 : sim_now();
 
-  while(1)
-  {
-    pthread_mutex_lock(&Mutex_WAITCOM);
-    Fuel_COM = (int)time(NULL) - (int)arg->arrival_timestamp;
-    if(Fuel_COM >= arg->fuel_reserve)
-    {
-      printf("EMERGENCY: Commercial Aircraft %d has ran out of reserved fuel and will land imminently!\n"
-        , arg->aircraft_id);
-      Commercial_Waiting--;
-      Fuel_Waiting_COM++;
-      pthread_mutex_unlock(&Mutex_WAITCOM);
-      pthread_mutex_lock(&Mutex_FUEL_COM);
-      while(!ready_FUEL_COM)
+  pthread_mutex_lock(&Mutex_CLOCK);
+  w->woken = 0;
+  w->timed_out = 0;
+  w->deadline = (virtual_time ? clock_now : now) + d;
+  timer_push(w);
+  if (!virtual_time && timer_heap[0] == w)
+    pthread_cond_signal(&timer_thread_cond);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+}
+
+/* Next runnable task, or NULL once the pool is stopping. */
+static sim_waiter *sim_runq_pop()
+{
+  sim_waiter *w;
+
+  pthread_mutex_lock(&Mutex_CLOCK);
+  while (runq_head == NULL && !pool_stopping)
+  {
+    sim_waiter idle;
+
+    waiter_init(&idle, SIM_FOREVER);
+    waitlist_append(&runq_idle_workers, &idle);
+    waiter_block_locked(&idle);
+    pthread_cond_destroy(&idle.cond);
+  }
+  w = runq_head;
+  if (w)
+  {
+    runq_head = w->runq_next;
+    if (runq_head == NULL)
+      runq_tail = NULL;
+  }
+  pthread_mutex_unlock(&Mutex_CLOCK);
+  return w;
+}
+
+static void *pool_worker(void *arg)
+{
+  sim_waiter *w;
+
+  (void)arg;
+  while ((w = sim_runq_pop()) != NULL)
+  {
+    w->task(w->task_arg);
+  }
+  sim_thread_end();
+  return NULL;
+}
+
+/* In wall-clock mode nothing advances the clock for parked tasks, so a
+ * helper thread sleeps until the earliest task deadline and fires it.
+ */
+static void *timer_thread(void *arg)
+{
+  (void)arg;
+  pthread_mutex_lock(&Mutex_CLOCK);
+  while (!pool_stopping)
+  {
+    if (timer_count == 0)
+    {
+      pthread_cond_wait(&timer_thread_cond, &Mutex_CLOCK);
+    }
+    else if (timer_heap[0]->deadline <= sim_now())
+    {
+      sim_waiter *w = timer_heap[0];
+
+      w->timed_out = 1;
+      waiter_wake_locked(w);
+    }
+    else
+    {
+      struct timespec abstime = sim_to_timespec(timer_heap[0]->deadline);
+
+      pthread_cond_timedwait(&timer_thread_cond, &Mutex_CLOCK, &abstime);
+    }
+  }
+  pthread_mutex_unlock(&Mutex_CLOCK);
+  return NULL;
+}
+
+static void sim_pool_start(int workers)
+{
+  int i;
+  int result;
+
+  pool_size = workers;
+  pool_tids = malloc(sizeof(*pool_tids) * workers);
+  if (pool_tids == NULL)
+  {
+    printf("runway: out of memory creating the worker pool\n");
+    exit(1);
+  }
+  for (i = 0; i < workers; i++)
+  {
+    sim_thread_begin();
+    result = pthread_create(&pool_tids[i], NULL, pool_worker, NULL);
+    if (result)
+    {
+      printf("runway: pthread_create failed for worker %d: %s\n", i, strerror(result));
+      exit(1);
+    }
+  }
+  if (!virtual_time)
+  {
+    pthread_cond_init(&timer_thread_cond, &clock_condattr);
+    result = pthread_create(&timer_tid, NULL, timer_thread, NULL);
+    if (result)
+    {
+      printf("runway: pthread_create failed for the timer thread: %s\n", strerror(result));
+      exit(1);
+    }
+    timer_thread_running = 1;
+  }
+}
+
+/* Stop the workers once the run queue has drained.  The caller must have
+ * left the simulation with sim_thread_end().
+ */
+static void sim_pool_stop()
+{
+  int i;
+
+  pthread_mutex_lock(&Mutex_CLOCK);
+  pool_stopping = 1;
+  while (runq_idle_workers.head)
+    waiter_wake_locked(runq_idle_workers.head);
+  if (timer_thread_running)
+    pthread_cond_signal(&timer_thread_cond);
+  pthread_mutex_unlock(&Mutex_CLOCK);
+  for (i = 0; i < pool_size; i++)
+    pthread_join(pool_tids[i], NULL);
+  if (timer_thread_running)
+    pthread_join(timer_tid, NULL);
+  free(pool_tids);
+
+  /* back to the initial state, so a later run can start a pool again */
+  pool_tids = NULL;
+  pool_size = 0;
+  pool_stopping = 0;
+  timer_thread_running = 0;
+}
+
+/* TODO */
+/* Add your synchronization variables here */
+
+/* basic information about simulation.  they are printed/checked at the end 
+* and in assert statements during execution.
+*
+* you are responsible for maintaining the integrity of these variables in the 
+* code that you develop. 
+*/
+pthread_mutex_t Mutex_DONE = PTHREAD_MUTEX_INITIALIZER;
+sim_cond_t Cond_DONE = SIM_COND_INITIALIZER;
+
+static int controller_shutdown = 0;      /* Set by main() once all aircraft are done */
+static int print_stats = 0;              /* set by --stats */
+static int aircraft_done = 0;            /* Aircraft that cleared the runway */
+static int runway_count = 1;             /* set by --runways */
+static sim_time_t makespan = 0;          /* When the last aircraft cleared the runway */
+static unsigned long long fuel_seed;     /* set by --seed, the time by default */
+static int record_waits = 0;             /* keep every wait time for the report */
+
+/* Next arrival that needs NORTH / SOUTH according to the arrival loop's
+ * forecast, SIM_FOREVER if none is known, and its runway time.
+ */
+pthread_mutex_t Mutex_FORECAST = PTHREAD_MUTEX_INITIALIZER;
+static sim_time_t forecast_due[2] = { SIM_FOREVER, SIM_FOREVER };
+static sim_time_t forecast_runway_time[2];
+
+/* Next arrival of any kind, SIM_FOREVER once the scenario is used up or 0
+ * while a stream's next aircraft has not come in, and the aircraft
+ * released by the arrival loop that have not queued yet.
+ */
+static sim_time_t forecast_next = SIM_FOREVER;
+static int arrivals_pending = 0;
+
+/* Backpressure on a stream input, see backlog_wait() */
+pthread_mutex_t Mutex_BACKLOG = PTHREAD_MUTEX_INITIALIZER;
+sim_cond_t Cond_BACKLOG = SIM_COND_INITIALIZER;
+static int streaming = 0;                /* the scenario is a stream */
+static int backlog_waiting = 0;          /* the arrival loop waits for the backlog to drop */
+static long backlog_stalls = 0;          /* times the stream was not read because of it */
+static sim_time_t backlog_stalled = 0;   /* for how long in total */
+
+/*** Runway state ***/
+
+/* Runway occupancy is packed into one 64-bit word so that admission and
+ * release are a single compare-and-swap and every reader sees a
+ * consistent picture.  Admission re-checks capacity, commercial/cargo
+ * separation and direction inside the CAS, so those invariants hold
+ * without a lock.
+ *
+ *   bits  0- 7  aircraft on the runway
+ *   bits  8-15  commercial aircraft on the runway
+ *   bits 16-23  cargo aircraft on the runway
+ *   bits 24-31  emergency aircraft on the runway
+ *   bits 32-39  direction (NORTH or SOUTH)
+ *   bits 40-55  consecutive aircraft in this direction (saturates)
+ */
+typedef unsigned long long runway_word;
+
+#define RUNWAY_TOTAL       0
+#define RUNWAY_COMMERCIAL  8
+#define RUNWAY_CARGO       16
+#define RUNWAY_EMERGENCY   24
+#define RUNWAY_DIRECTION   32
+#define RUNWAY_CONSECUTIVE 40
+#define RUNWAY_CONSECUTIVE_MAX 0xffff
+
+static long runway_cas_retries = 0;
+
+/* Decoded copy of runway_state. */
+typedef struct
+{
+  int total;
+  int commercial;
+  int cargo;
+  int emergency;
+  int direction;
+  int consecutive;
+} runway_view;
+
+static int runway_get(runway_word w, int field)
+{
+  unsigned mask = field == RUNWAY_CONSECUTIVE ? RUNWAY_CONSECUTIVE_MAX : 0xff;
+
+  return (int)((w >> field) & mask);
+}
+
+static runway_view runway_snapshot(runway_word *state)
+{
+  runway_word w = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+  runway_view v;
+
+  v.total       = runway_get(w, RUNWAY_TOTAL);
+  v.commercial  = runway_get(w, RUNWAY_COMMERCIAL);
+  v.cargo       = runway_get(w, RUNWAY_CARGO);
+  v.emergency   = runway_get(w, RUNWAY_EMERGENCY);
+  v.direction   = runway_get(w, RUNWAY_DIRECTION);
+  v.consecutive = runway_get(w, RUNWAY_CONSECUTIVE);
+  return v;
+}
+
+/* Replace *old with new.  On failure *old is refreshed and 0 returned. */
+static int runway_cas(runway_word *state, runway_word *old, runway_word new)
+{
+  if (__atomic_compare_exchange_n(state, old, new, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    return 1;
+  __atomic_fetch_add(&runway_cas_retries, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+static int runway_type_field(int type)
+{
+  if (type == COMMERCIAL)
+    return RUNWAY_COMMERCIAL;
+  if (type == CARGO)
+    return RUNWAY_CARGO;
+  return RUNWAY_EMERGENCY;
+}
+
+/* Whether an aircraft of the given type may join a runway in state w:
+ * there is room, commercial and cargo aircraft do not mix and the
+ * direction fits.
+ */
+static int runway_admissible(runway_word w, int type)
+{
+  int direction = runway_get(w, RUNWAY_DIRECTION);
+
+  if (runway_get(w, RUNWAY_TOTAL) >= config.max_runway_capacity)
+    return 0;
+  if (type == COMMERCIAL && (runway_get(w, RUNWAY_CARGO) > 0 || direction != NORTH))
+    return 0;
+  if (type == CARGO && (runway_get(w, RUNWAY_COMMERCIAL) > 0 || direction != SOUTH))
+    return 0;
+  return 1;
+}
+
+/* Put an aircraft of the given type on the runway.  Returns 0 and changes
+ * nothing if runway_admissible() says no, otherwise the new state word
+ * (never 0, since the runway is then occupied).
+ */
+static runway_word runway_try_admit(runway_word *state, int type)
+{
+  runway_word old = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+  runway_word new;
+
+  do
+  {
+    if (!runway_admissible(old, type))
+      return 0;
+    new = old + (1ULL << RUNWAY_TOTAL) + (1ULL << runway_type_field(type));
+    if (runway_get(old, RUNWAY_CONSECUTIVE) < RUNWAY_CONSECUTIVE_MAX)
+      new += 1ULL << RUNWAY_CONSECUTIVE;
+  } while (!runway_cas(state, &old, new));
+  return new;
+}
+
+/* Take an aircraft of the given type off the runway.  Returns the new
+ * state word.
+ */
+static runway_word runway_release(runway_word *state, int type)
+{
+  runway_word old = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+  runway_word new;
+
+  do
+  {
+    assert(runway_get(old, RUNWAY_TOTAL) > 0 && runway_get(old, runway_type_field(type)) > 0);
+    new = old - (1ULL << RUNWAY_TOTAL) - (1ULL << runway_type_field(type));
+  } while (!runway_cas(state, &old, new));
+  return new;
+}
+
+/* Set the direction and restart the consecutive count.  Returns the new
+ * state word.
+ */
+static runway_word runway_set_direction(runway_word *state, int direction)
+{
+  runway_word old = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+  runway_word new;
+
+  do
+  {
+    new = old & ~((0xffULL << RUNWAY_DIRECTION)
+                  | ((runway_word)RUNWAY_CONSECUTIVE_MAX << RUNWAY_CONSECUTIVE));
+    new |= (runway_word)direction << RUNWAY_DIRECTION;
+  } while (!runway_cas(state, &old, new));
+  return new;
+}
+
+typedef struct aircraft_info
+{
+  sim_time_t arrival_time;  // ns between the arrival of the previous aircraft and this one
+  sim_time_t runway_time;   // ns the aircraft needs to spend on the runway
+  int aircraft_id;
+  int aircraft_type;        // COMMERCIAL, CARGO, or EMERGENCY
+  sim_time_t fuel_reserve;  // ns of reserve fuel, random between config.fuel_min and config.fuel_max s
+  sim_time_t fuel_deadline; // when the aircraft becomes fuel-critical if still waiting
+  long long sched_key;      // set by the scheduling policy when it is queued
+  sim_time_t times[LIFE_EVENTS]; // sim_now() at each LIFE_* event, LIFE_NONE if not reached;
+                                 // fuel is counted from times[LIFE_ARRIVAL]
+  int landing_direction;    // runway direction when it was granted
+  int fuel_critical;        // set by the controller once fuel_deadline has passed
+  sim_time_t urgent_deadline; // when a waiting emergency goes ahead of fuel-critical aircraft
+  int emergency_urgent;     // set by the controller once urgent_deadline has passed
+  int heap_index[HEAP_SLOTS]; // position in each aircraft_heap, -1 if not queued
+  int state;                // AIRCRAFT_ARRIVING ... AIRCRAFT_CLEARED
+  sim_cond_t grant;         // signalled by the controller when it grants the runway
+  struct runway_info *runway; // runway whose queue it waits in, then lands on
+  int schedule_step;        // schedule records about it so far, see schedule_note()
+  int watchdog_flagged;     // already reported as starving by the watchdog
+  sim_time_t watchdog_due;  // when the watchdog reports it as starving
+  sim_waiter task;          // run queue / wait list entry when on the worker pool
+  struct aircraft_info *arena_next; // free list link while the record is unused
+} aircraft_info;
+
+/*** Aircraft arena ***/
+
+/* Aircraft records live in fixed-size chunks that are never moved, so the
+ * pointers held by threads, heaps and wait lists stay valid.  Records of
+ * aircraft that have cleared the runway go on a free list and are reused,
+ * so memory follows the number of aircraft in flight rather than the
+ * length of the scenario.
+ */
+typedef struct aircraft_chunk
+{
+  struct aircraft_chunk *next;
+  aircraft_info records[AIRCRAFT_CHUNK];
+} aircraft_chunk;
+
+static pthread_mutex_t Mutex_ARENA = PTHREAD_MUTEX_INITIALIZER;
+static aircraft_chunk *arena_chunks = NULL;   /* newest chunk first */
+static int arena_chunk_used = AIRCRAFT_CHUNK; /* records handed out from arena_chunks */
+static aircraft_info *arena_free = NULL;
+static long arena_records = 0;                /* records ever carved from chunks */
+
+static aircraft_info *aircraft_alloc()
+{
+  aircraft_info *ai;
+
+  pthread_mutex_lock(&Mutex_ARENA);
+  if (arena_free)
+  {
+    ai = arena_free;
+    arena_free = ai->arena_next;
+  }
+  else
+  {
+    if (arena_chunk_used == AIRCRAFT_CHUNK)
+    {
+      aircraft_chunk *chunk = malloc(sizeof(*chunk));
+
+      if (chunk == NULL)
       {
-        pthread_cond_wait(&Cond_FUEL_COM, &Mutex_FUEL_COM);
+        printf("runway: out of memory allocating aircraft records\n");
+        exit(1);
       }
-      aircraft_on_runway    = aircraft_on_runway + 1;
-      aircraft_since_break  = aircraft_since_break + 1;
-      commercial_on_runway  = commercial_on_runway + 1;
-      consecutive_direction = consecutive_direction + 1;
-      ready_FUEL_COM = 0;
-      Priority_COM = 0;
-      Fuel_Waiting_COM--;
-      pthread_mutex_unlock(&Mutex_FUEL_COM);
+      chunk->next = arena_chunks;
+      arena_chunks = chunk;
+      arena_chunk_used = 0;
+    }
+    ai = &arena_chunks->records[arena_chunk_used++];
+    arena_records++;
+  }
+  pthread_mutex_unlock(&Mutex_ARENA);
+  return ai;
+}
+
+/* Clear the state ai carries through a run, before it arrives.  The
+ * scenario fields (type, times, fuel) are the caller's.
+ */
+static void aircraft_reset(aircraft_info *ai)
+{
+  int i;
+
+  ai->fuel_critical = 0;
+  ai->emergency_urgent = 0;
+  for (i = 0; i < LIFE_EVENTS; i++)
+    ai->times[i] = LIFE_NONE;
+  for (i = 0; i < HEAP_SLOTS; i++)
+    ai->heap_index[i] = -1;
+  ai->state = AIRCRAFT_ARRIVING;
+  ai->grant.head = NULL;
+  ai->grant.tail = NULL;
+  ai->runway = NULL;
+  ai->schedule_step = 0;
+  ai->watchdog_flagged = 0;
+}
+
+static void aircraft_release(aircraft_info *ai)
+{
+  pthread_mutex_lock(&Mutex_ARENA);
+  ai->arena_next = arena_free;
+  arena_free = ai;
+  pthread_mutex_unlock(&Mutex_ARENA);
+}
+
+static void aircraft_arena_destroy()
+{
+  while (arena_chunks)
+  {
+    aircraft_chunk *next = arena_chunks->next;
+
+    free(arena_chunks);
+    arena_chunks = next;
+  }
+  arena_chunk_used = AIRCRAFT_CHUNK;
+  arena_free = NULL;
+}
+
+/*** Aircraft heaps ***/
+
+/* Indexed binary min-heap of aircraft.  Each heap uses its own slot of
+ * aircraft_info.heap_index so an aircraft can be removed or re-keyed in
+ * O(log n) and can sit in several heaps at once.  Heaps are not locked;
+ * the owner of the heap provides the mutex.
+ */
+typedef struct
+{
+  aircraft_info **items;
+  int count;
+  int capacity;
+  int slot;                 /* which heap_index[] entry this heap maintains */
+  int (*before)(const aircraft_info *a, const aircraft_info *b);
+} aircraft_heap;
+
+static void aircraft_heap_swap(aircraft_heap *h, int a, int b)
+{
+  aircraft_info *t = h->items[a];
+
+  h->items[a] = h->items[b];
+  h->items[b] = t;
+  h->items[a]->heap_index[h->slot] = a;
+  h->items[b]->heap_index[h->slot] = b;
+}
+
+static void aircraft_heap_sift_up(aircraft_heap *h, int i)
+{
+  while (i > 0 && h->before(h->items[i], h->items[(i - 1) / 2]))
+  {
+    aircraft_heap_swap(h, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void aircraft_heap_sift_down(aircraft_heap *h, int i)
+{
+  while (1)
+  {
+    int first = i;
+    int l = 2 * i + 1;
+    int r = 2 * i + 2;
+
+    if (l < h->count && h->before(h->items[l], h->items[first]))
+      first = l;
+    if (r < h->count && h->before(h->items[r], h->items[first]))
+      first = r;
+    if (first == i)
       return;
+    aircraft_heap_swap(h, i, first);
+    i = first;
+  }
+}
+
+static void aircraft_heap_push(aircraft_heap *h, aircraft_info *ai)
+{
+  if (h->count == h->capacity)
+  {
+    h->capacity = h->capacity ? h->capacity * 2 : 64;
+    h->items = realloc(h->items, sizeof(*h->items) * h->capacity);
+    if (h->items == NULL)
+    {
+      printf("runway: out of memory growing an aircraft heap\n");
+      exit(1);
     }
-    if(Signal_COM == 1)
+  }
+  ai->heap_index[h->slot] = h->count;
+  h->items[h->count++] = ai;
+  aircraft_heap_sift_up(h, h->count - 1);
+}
+
+static aircraft_info *aircraft_heap_top(aircraft_heap *h)
+{
+  return h->count > 0 ? h->items[0] : NULL;
+}
+
+static void aircraft_heap_remove(aircraft_heap *h, aircraft_info *ai)
+{
+  int i = ai->heap_index[h->slot];
+
+  if (i < 0)
+    return;
+  ai->heap_index[h->slot] = -1;
+  h->count--;
+  if (i == h->count)
+    return;
+  h->items[i] = h->items[h->count];
+  h->items[i]->heap_index[h->slot] = i;
+  aircraft_heap_sift_up(h, i);
+  aircraft_heap_sift_down(h, h->items[i]->heap_index[h->slot]);
+}
+
+/* Restore the heap order after the key of ai has changed. */
+static void aircraft_heap_update(aircraft_heap *h, aircraft_info *ai)
+{
+  int i = ai->heap_index[h->slot];
+
+  if (i < 0)
+    return;
+  aircraft_heap_sift_up(h, i);
+  aircraft_heap_sift_down(h, ai->heap_index[h->slot]);
+}
+
+/* Re-heapify after the ordering itself has changed. */
+static void aircraft_heap_rebuild(aircraft_heap *h)
+{
+  int i;
+
+  for (i = h->count / 2 - 1; i >= 0; i--)
+  {
+    aircraft_heap_sift_down(h, i);
+  }
+}
+
+static int fuel_deadline_before(const aircraft_info *a, const aircraft_info *b)
+{
+  return a->fuel_deadline < b->fuel_deadline;
+}
+
+static int urgent_deadline_before(const aircraft_info *a, const aircraft_info *b)
+{
+  return a->urgent_deadline < b->urgent_deadline;
+}
+
+/*** Samples ***/
+
+/* Growable array of measurements (seconds or counts) that the report
+ * turns into percentiles.
+ */
+typedef struct
+{
+  double *items;
+  long count;
+  long capacity;
+} sample_vec;
+
+static void sample_push(sample_vec *v, double x)
+{
+  if (v->count == v->capacity)
+  {
+    long capacity = v->capacity ? 2 * v->capacity : 256;
+    double *items = realloc(v->items, capacity * sizeof(*items));
+
+    if (items == NULL)
     {
-      Signal_COM = 0;
-      pthread_mutex_unlock(&Mutex_WAITCOM);
-      break;
+      printf("runway: out of memory recording samples\n");
+      exit(1);
     }
-    pthread_mutex_unlock(&Mutex_WAITCOM);
-    sleep(1);
+    v->items = items;
+    v->capacity = capacity;
+  }
+  v->items[v->count++] = x;
+}
+
+static int sample_compare(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Value below which a fraction p of the samples fall.  v must be sorted. */
+static double sample_percentile(const sample_vec *v, double p)
+{
+  long i = (long)(p * v->count);
+
+  if (v->count == 0)
+    return 0.0;
+  return v->items[i < v->count ? i : v->count - 1];
+}
+
+static double sample_mean(const sample_vec *v)
+{
+  double sum = 0.0;
+  long i;
+
+  for (i = 0; i < v->count; i++)
+    sum += v->items[i];
+  return v->count ? sum / v->count : 0.0;
+}
+
+/* Sample standard deviation of v, 0 with fewer than two samples. */
+static double sample_sd(const sample_vec *v)
+{
+  double mean = sample_mean(v), sum = 0.0;
+  long i;
+
+  for (i = 0; i < v->count; i++)
+    sum += (v->items[i] - mean) * (v->items[i] - mean);
+  return v->count > 1 ? sqrt(sum / (v->count - 1)) : 0.0;
+}
+
+/* Print " M ± SD" for v in a table column width characters wide. */
+static void print_spread(int width, const sample_vec *v)
+{
+  printf(" %*.1f ± %5.1f", width - 8, sample_mean(v), sample_sd(v));
+}
+
+/* Print "label  n N, mean M, p50 ... max X" for v, sorting it. */
+static void print_distribution(const char *label, sample_vec *v)
+{
+  double sum = 0.0;
+  long i;
+
+  qsort(v->items, v->count, sizeof(*v->items), sample_compare);
+  for (i = 0; i < v->count; i++)
+    sum += v->items[i];
+  printf("%-29sn %ld, mean %.2f, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+         label, v->count, v->count ? sum / v->count : 0.0,
+         sample_percentile(v, 0.50), sample_percentile(v, 0.90),
+         sample_percentile(v, 0.99), v->count ? v->items[v->count - 1] : 0.0);
+}
+
+/*** Aircraft lifecycle ***/
+
+/* Each aircraft carries the times of its LIFE_* events.  When it has
+ * cleared the runway the thread that ran it copies them into the
+ * aircraft's own slot of a table indexed by aircraft id, so recording
+ * never touches a shared lock, stdio or the allocator.  The table is
+ * sized before the run from the scenario's aircraft count; for a stream
+ * the arrival loop grows it ahead of the ids it hands out.  Page k holds
+ * LIFE_PAGE_RECORDS << k records, so pages never move while aircraft
+ * write to them.  The report merges the table into log-linear (HDR
+ * style) histograms.
+ */
+#define LIFE_PAGE_RECORDS 256     /* records in the first page */
+#define LIFE_PAGES        24      /* enough pages for every int id */
+
+typedef struct
+{
+  int aircraft_type;
+  int direction;
+  sim_time_t times[LIFE_EVENTS];
+} lifecycle_entry;
+
+static lifecycle_entry *lifecycle_pages[LIFE_PAGES];
+static int lifecycle_page_count = 0;
+static long lifecycle_capacity = 0;      /* ids the pages cover */
+static long lifecycle_count = 0;         /* aircraft released by the last run */
+
+static const char *type_names[3] = { "commercial", "cargo", "emergency" };
+
+/* Make room for the aircraft ids below count.  Returns ENOMEM if a page
+ * cannot be allocated.
+ */
+static int lifecycle_reserve(long count)
+{
+  while (lifecycle_capacity < count)
+  {
+    long records = (long)LIFE_PAGE_RECORDS << lifecycle_page_count;
+
+    if (lifecycle_page_count == LIFE_PAGES
+        || (lifecycle_pages[lifecycle_page_count] = malloc(records * sizeof(lifecycle_entry))) == NULL)
+      return ENOMEM;
+    lifecycle_page_count++;
+    lifecycle_capacity += records;
+  }
+  return 0;
+}
+
+static lifecycle_entry *lifecycle_slot(long id)
+{
+  int page = 63 - __builtin_clzll((unsigned long long)(id / LIFE_PAGE_RECORDS + 1));
+
+  return &lifecycle_pages[page][id - LIFE_PAGE_RECORDS * ((1L << page) - 1)];
+}
+
+/* Copy ai's lifecycle into its slot. */
+static void lifecycle_record(aircraft_info *ai)
+{
+  lifecycle_entry *rec = lifecycle_slot(ai->aircraft_id);
+
+  rec->aircraft_type = ai->aircraft_type;
+  rec->direction = ai->landing_direction;
+  memcpy(rec->times, ai->times, sizeof(rec->times));
+}
+
+static void lifecycle_destroy()
+{
+  while (lifecycle_page_count > 0)
+    free(lifecycle_pages[--lifecycle_page_count]);
+  lifecycle_capacity = 0;
+  lifecycle_count = 0;
+}
+
+/* Latency histogram with HIST_SUB_COUNT / 2 linear buckets per power of
+ * two, i.e. about 1.6% relative error at any magnitude.
+ */
+#define HIST_SUB_BITS  7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS   ((64 - HIST_SUB_BITS + 1) * (HIST_SUB_COUNT / 2))
+
+typedef struct
+{
+  long counts[HIST_BUCKETS];
+  long total;
+  sim_time_t max;
+} latency_hist;
+
+static int hist_index(sim_time_t v)
+{
+  int shift;
+
+  if (v < HIST_SUB_COUNT)
+    return v < 0 ? 0 : (int)v;
+  shift = 63 - __builtin_clzll((unsigned long long)v) - HIST_SUB_BITS + 1;
+  return shift * (HIST_SUB_COUNT / 2) + (int)(v >> shift);
+}
+
+/* Largest value that falls into bucket i. */
+static sim_time_t hist_value(int i)
+{
+  int shift;
+
+  if (i < HIST_SUB_COUNT)
+    return i;
+  shift = i / (HIST_SUB_COUNT / 2) - 1;
+  return (((sim_time_t)(i - shift * (HIST_SUB_COUNT / 2)) + 1) << shift) - 1;
+}
+
+static void hist_add(latency_hist *h, sim_time_t v)
+{
+  h->counts[hist_index(v)]++;
+  h->total++;
+  if (v > h->max)
+    h->max = v;
+}
+
+static sim_time_t hist_percentile(const latency_hist *h, double p)
+{
+  long rank = (long)(p * h->total);
+  long seen = 0;
+  int i;
+
+  for (i = 0; i < HIST_BUCKETS; i++)
+  {
+    seen += h->counts[i];
+    if (seen > rank)
+      return hist_value(i) < h->max ? hist_value(i) : h->max;
+  }
+  return h->max;
+}
+
+/* Wait (enqueue to grant), runway dwell (runway start to clear) and end
+ * to end (arrival to clear) histograms by aircraft type and landing
+ * direction, printed at the end of --stats.
+ */
+static void print_lifecycle_report()
+{
+  static const char *metrics[3] = { "wait", "dwell", "end-to-end" };
+  static const int from[3] = { LIFE_ENQUEUE, LIFE_RUNWAY, LIFE_ARRIVAL };
+  static const int to[3] = { LIFE_GRANT, LIFE_CLEAR, LIFE_CLEAR };
+  latency_hist *hist = calloc(3 * 3 * 2, sizeof(*hist));
+  long escalated[3][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+  latency_hist *h;
+  int m, type, dir;
+  long i;
+
+  if (hist == NULL)
+  {
+    printf("runway: out of memory building histograms\n");
+    return;
+  }
+
+  for (i = 0; i < lifecycle_count; i++)
+  {
+    lifecycle_entry *rec = lifecycle_slot(i);
+
+    for (m = 0; m < 3; m++)
+    {
+      if (rec->times[from[m]] != LIFE_NONE && rec->times[to[m]] != LIFE_NONE)
+        hist_add(&hist[(m * 3 + rec->aircraft_type) * 2 + rec->direction],
+                 rec->times[to[m]] - rec->times[from[m]]);
+    }
+    if (rec->times[LIFE_FUEL] != LIFE_NONE)
+      escalated[rec->aircraft_type][rec->direction]++;
+  }
+
+  printf("\n=== Aircraft lifecycle (seconds) ===\n");
+  printf("%-11s %-10s %-5s %7s %9s %9s %9s %9s %9s %5s\n", "", "type", "dir",
+         "count", "p50", "p90", "p99", "p99.9", "max", "fuel");
+  for (m = 0; m < 3; m++)
+  {
+    for (type = 0; type < 3; type++)
+    {
+      for (dir = NORTH; dir <= SOUTH; dir++)
+      {
+        h = &hist[(m * 3 + type) * 2 + dir];
+        if (h->total == 0)
+          continue;
+        printf("%-11s %-10s %-5s %7ld %9.3f %9.3f %9.3f %9.3f %9.3f %5ld\n",
+               metrics[m], type_names[type], dir == NORTH ? "NORTH" : "SOUTH", h->total,
+               (double)hist_percentile(h, 0.50) / NSEC_PER_SEC,
+               (double)hist_percentile(h, 0.90) / NSEC_PER_SEC,
+               (double)hist_percentile(h, 0.99) / NSEC_PER_SEC,
+               (double)hist_percentile(h, 0.999) / NSEC_PER_SEC,
+               (double)h->max / NSEC_PER_SEC, escalated[type][dir]);
+      }
+    }
+  }
+  free(hist);
+}
+
+/*** Runways ***/
+
+/* One runway with its own controller thread, wait queue, direction and
+ * break cycle.  mutex protects the queues and the controller's
+ * bookkeeping; occupancy is the atomic state word and needs no lock.
+ */
+typedef struct runway_info
+{
+  int id;
+  char label[24];               /* appended to messages, empty with one runway */
+  runway_word state;
+  pthread_mutex_t mutex;
+  aircraft_heap wait_queue;     /* waiting aircraft, best candidate on top */
+  aircraft_heap fuel_heap;      /* fuel deadlines of queued commercial/cargo */
+  aircraft_heap urgent_heap;    /* urgent deadlines of queued emergencies */
+  int waiting_for[2];           /* queued aircraft that need NORTH / SOUTH */
+  int queue_direction;          /* direction wait_queue is currently ordered for */
+  int queued;                   /* wait_queue.count, readable without the mutex */
+  int queue_peak;               /* longest the wait queue has been */
+  int aircraft_since_break;     /* aircraft admitted since the last break */
+
+  /* Controller wake-ups.  Anything that can change an admission decision
+   * (arrival, admission, departure, fuel escalation) bumps
+   * controller_events; the controller sleeps on controller_cond while it
+   * is zero.
+   */
+  pthread_t controller_tid;
+  pthread_mutex_t controller_mutex;
+  sim_cond_t controller_cond;
+  int controller_events;        /* events since the last evaluation */
+  int controller_idle;          /* controller is sleeping on controller_cond */
+  sim_time_t controller_event_time; /* when the event that woke it was posted */
+  long controller_wakeups;
+  long controller_passes;
+  sim_time_t controller_latency_total;
+  sim_time_t controller_latency_max;
+  long controller_notifies;
+  long controller_notify_locks; /* notifications that had to take the mutex */
+
+  /* Utilization, under mutex */
+  int busy;                     /* an aircraft has been on it since busy_since */
+  sim_time_t busy_since;
+  sim_time_t busy_total;
+  long landings;
+  long switches;
+  long breaks;
+  long stolen;                  /* aircraft taken from other runways' queues */
+  long breaks_overlapped;       /* breaks taken during a switch, see admit_aircraft() */
+  long breaks_idle;             /* breaks taken early while nobody was waiting */
+  long holds;                   /* switches the planner put off, see plan_hold() */
+  sim_time_t plan_until;        /* re-plan at this time if nothing happens first */
+  sim_time_t plan_due;          /* arrival the current hold is for */
+  long fuel_emergencies;        /* aircraft that ran out of reserve fuel */
+  int blocked;                  /* on a break or switching, see controller_pause() */
+  sim_time_t blocked_waiting;   /* since when somebody waits for the block to end */
+  sim_time_t dead_time;         /* blocked time with aircraft waiting */
+  sample_vec waits[3];          /* seconds from queueing to grant, by type */
+
+  /* --record and --replay, see schedule_note() and replay_decisions() */
+  schedule_record *decisions;   /* recorded so far, under mutex */
+  long decision_count;
+  long decision_capacity;
+  long replay_next;             /* this runway's next record in replay_records */
+  long replay_end;
+  long replay_late;             /* decisions replayed later than recorded */
+
+  /* --live-stats, see live_publish() */
+  int live_waits[LIVE_WAITS];   /* ms waits of the latest grants, a ring */
+  long live_wait_count;         /* grants pushed to live_waits */
+  long live_wait_published;     /* of them copied to the segment */
+
+  /* --watchdog, see watchdog_note() and watchdog_check_runway(), under mutex */
+  aircraft_heap watchdog_heap;  /* waiting aircraft not reported yet, by watchdog_due */
+  int last_decision;            /* SCHED_* of the controller's latest decision, -1 if none */
+  int last_decision_aircraft;   /* the aircraft it was about, -1 if none */
+  sim_time_t last_decision_time;
+} runway_info;
+
+static runway_info *runways = NULL;
+
+/*** Live statistics ***/
+
+/* With --live-stats the simulator publishes its counters to a POSIX
+ * shared-memory segment (runway_stats.h) for runway-top to watch.  Each
+ * runway's part is written only by its controller and the header only
+ * by the arrival loop, each under its own seqlock, so publishing takes
+ * no lock and makes no system call, and a reader can never hold up the
+ * simulation.
+ */
+static char *live_name = NULL;                   /* segment name, NULL if off */
+static live_header *live = NULL;                 /* the mapped segment */
+static size_t live_size = 0;
+
+static live_runway *live_runways()
+{
+  return (live_runway *)(live + 1);
+}
+
+/* Start a seqlock write of the part guarded by *seq. */
+static void live_write_begin(unsigned long long *seq)
+{
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void live_write_end(unsigned long long *seq)
+{
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Create the --live-stats segment for a run of aircraft aircraft.  A
+ * segment left by an earlier run is replaced; a runway-top still
+ * watching it sees that run as finished.
+ */
+static void live_open(long long aircraft)
+{
+  int fd;
+
+  if (live_name == NULL)
+    return;
+  live_size = sizeof(live_header) + runway_count * sizeof(live_runway);
+  shm_unlink(live_name);
+  fd = shm_open(live_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 || ftruncate(fd, live_size) != 0)
+  {
+    printf("runway: cannot create live statistics segment %s: %s\n", live_name, strerror(errno));
+    exit(1);
+  }
+  live = mmap(NULL, live_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (live == MAP_FAILED)
+  {
+    printf("runway: cannot map live statistics segment %s: %s\n", live_name, strerror(errno));
+    exit(1);
+  }
+
+  live->version = LIVE_VERSION;
+  live->runway_size = sizeof(live_runway);
+  live->runway_count = runway_count;
+  live->pid = (int)getpid();
+  live->virtual_time = virtual_time;
+  live->aircraft = aircraft;
+  /* the magic goes last, so a reader never sees a half-made header */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(live->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC));
+}
+
+/* Publish the arrival of the arrived'th aircraft. */
+static void live_arrival(long long arrived)
+{
+  if (live == NULL)
+    return;
+  live_write_begin(&live->seq);
+  live->time = sim_now();
+  live->arrived = arrived;
+  live_write_end(&live->seq);
+}
+
+/* Publish r's counters.  Called by r's controller, which holds r->mutex.
+ * Only the waits of grants since the last call are copied.
+ */
+static void live_publish(runway_info *r)
+{
+  live_runway *lr;
+  runway_view rv;
+  long k;
+
+  if (live == NULL)
+    return;
+  lr = &live_runways()[r->id];
+  rv = runway_snapshot(&r->state);
+  live_write_begin(&lr->seq);
+  lr->on_runway = rv.total;
+  lr->on_runway_type[COMMERCIAL] = rv.commercial;
+  lr->on_runway_type[CARGO] = rv.cargo;
+  lr->on_runway_type[EMERGENCY] = rv.emergency;
+  lr->waiting[COMMERCIAL] = r->waiting_for[NORTH];
+  lr->waiting[CARGO] = r->waiting_for[SOUTH];
+  lr->waiting[EMERGENCY] = r->wait_queue.count - r->waiting_for[NORTH] - r->waiting_for[SOUTH];
+  lr->direction = rv.direction;
+  lr->consecutive = rv.consecutive;
+  lr->since_break = r->aircraft_since_break;
+  lr->blocked = r->blocked;
+  lr->landings = r->landings;
+  lr->fuel_emergencies = r->fuel_emergencies;
+  lr->breaks = r->breaks;
+  lr->switches = r->switches;
+  if (r->live_wait_count - r->live_wait_published > LIVE_WAITS)
+    r->live_wait_published = r->live_wait_count - LIVE_WAITS;
+  for (k = r->live_wait_published; k < r->live_wait_count; k++)
+    lr->recent_waits[k % LIVE_WAITS] = r->live_waits[k % LIVE_WAITS];
+  r->live_wait_published = r->live_wait_count;
+  lr->wait_count = r->live_wait_count < LIVE_WAITS ? (int)r->live_wait_count : LIVE_WAITS;
+  live_write_end(&lr->seq);
+}
+
+/* Mark the run as finished and remove the segment.  A runway-top that has
+ * it mapped keeps the final numbers.
+ */
+static void live_close()
+{
+  if (live == NULL)
+    return;
+  live_write_begin(&live->seq);
+  live->time = makespan;
+  live->done = 1;
+  live_write_end(&live->seq);
+  munmap(live, live_size);
+  shm_unlink(live_name);
+  live = NULL;
+}
+
+/*** Watchdog ***/
+
+/* --watchdog[=SECONDS] keeps an eye on the run from two threads, see
+ * watchdog_start():
+ *  - watchdog_timer(), a simulation thread, reports an emergency aircraft
+ *    that has waited longer than config.emergency_timeout, and an
+ *    aircraft that is still waiting that long after its fuel ran out.  It
+ *    sleeps on the simulation clock until the next such deadline, so it
+ *    sees every one in virtual time as well.
+ *  - watchdog_thread(), outside the simulation, looks once a second of
+ *    wall-clock time for a stall: aircraft are in flight, but for SECONDS
+ *    nothing has happened, no arrival, decision, departure or end of a
+ *    break or switch.  It then logs a snapshot of who waits on what and
+ *    what each controller decided last.  SIGUSR1 asks for one as well.
+ * Reports are LOG_WATCH* event records, so they come out in order with
+ * the other events, or go to the --binary-log.  The simulation threads
+ * only count events and note decisions under locks they already hold.
+ */
+#define WATCHDOG_DEFAULT 10      /* --watchdog stall threshold in seconds */
+#define WATCHDOG_OLDEST  5       /* waiting aircraft shown per runway */
+
+static int watchdog_seconds = 0;                 /* set by --watchdog, 0 if off */
+pthread_mutex_t Mutex_WATCHDOG = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Cond_WATCHDOG;                    /* wakes watchdog_thread(), on CLOCK_MONOTONIC */
+sim_cond_t Cond_WATCHDOG_TIMER = SIM_COND_INITIALIZER;  /* wakes watchdog_timer() */
+static pthread_t watchdog_tid;
+static pthread_t watchdog_timer_tid;
+static int watchdog_stopping = 0;
+static int watchdog_timer_idle = 0;              /* watchdog_timer() waits for an aircraft */
+static volatile sig_atomic_t watchdog_dump_requested = 0;   /* by SIGUSR1 */
+static long watchdog_progress = 0;               /* events so far */
+static long watchdog_stalls = 0;
+static long watchdog_starving = 0;               /* aircraft reported as starving */
+static long watchdog_queued = 0;                 /* aircraft queued or stolen so far */
+
+static const char *decision_names[] =
+{
+  "queue", "steal", "grant", "break", "idle break", "switch", "switch with break"
+};
+
+/* Something happened that moves the simulation on. */
+static void watchdog_tick()
+{
+  if (watchdog_seconds > 0)
+    __atomic_fetch_add(&watchdog_progress, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Remember r's latest controller decision for the snapshot, and wake
+ * watchdog_timer() if an aircraft queues while no other one waits.
+ * Called from schedule_note(), with r->mutex held.
+ */
+static void watchdog_note(runway_info *r, int decision, aircraft_info *ai)
+{
+  if (watchdog_seconds == 0)
+    return;
+  watchdog_tick();
+  if (decision == SCHED_QUEUE || decision == SCHED_STEAL)
+  {
+    __atomic_fetch_add(&watchdog_queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&watchdog_timer_idle, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_lock(&Mutex_WATCHDOG);
+      sim_cond_signal(&Cond_WATCHDOG_TIMER);
+      pthread_mutex_unlock(&Mutex_WATCHDOG);
+    }
+  }
+  if (decision == SCHED_QUEUE)
+    return;
+  r->last_decision = decision;
+  r->last_decision_aircraft = ai ? ai->aircraft_id : -1;
+  r->last_decision_time = sim_now();
+}
+
+static void watchdog_signal(int sig)
+{
+  (void)sig;
+  watchdog_dump_requested = 1;
+}
+
+static int watchdog_due_before(const aircraft_info *a, const aircraft_info *b)
+{
+  return a->watchdog_due < b->watchdog_due;
+}
+
+/*** Recorded schedules ***/
+
+/* The same seed gives the same scenario but not the same run: threads
+ * that wake at the same virtual instant race for the queue, and with
+ * several runways the runway an aircraft queues at and which controller
+ * steals it depend on how the threads interleave as well.  --record
+ * writes every decision to a file (see runway_schedule.h) and --replay
+ * makes the controllers take exactly those decisions again, each no
+ * earlier than it was recorded, so the run has the same timeline.
+ */
+#define SCHEDULE_OFF    0
+#define SCHEDULE_RECORD 1
+#define SCHEDULE_REPLAY 2
+
+static int schedule_mode = SCHEDULE_OFF;         /* set by --record and --replay */
+static char *schedule_path = NULL;
+static void *replay_map = NULL;                  /* the --replay file, mapped */
+static size_t replay_size = 0;
+static const schedule_record *replay_records = NULL;
+static long *replay_offsets = NULL;              /* first record of each runway */
+static int *replay_route = NULL;                 /* runway each aircraft queues at */
+static aircraft_info **replay_aircraft = NULL;   /* aircraft by id, set on arrival */
+static long long replay_aircraft_count = 0;
+
+/* Append a decision of r's controller, or the runway an aircraft chose,
+ * to r's schedule when recording.  The aircraft's step is counted in
+ * every mode, so a replay knows which of its records comes next.  Caller
+ * holds r->mutex, and ai waits at r.
+ */
+static void schedule_note(runway_info *r, int decision, aircraft_info *ai)
+{
+  schedule_record *d;
+  int step = ai ? ai->schedule_step++ : 0;
+
+  watchdog_note(r, decision, ai);
+  if (schedule_mode != SCHEDULE_RECORD)
+    return;
+  if (r->decision_count == r->decision_capacity)
+  {
+    long capacity = r->decision_capacity ? 2 * r->decision_capacity : 1024;
+    schedule_record *decisions = realloc(r->decisions, capacity * sizeof(*decisions));
+
+    if (decisions == NULL)
+    {
+      printf("runway: out of memory recording the schedule\n");
+      exit(1);
+    }
+    r->decisions = decisions;
+    r->decision_capacity = capacity;
+  }
+  d = &r->decisions[r->decision_count++];
+  d->time = sim_now();
+  d->aircraft_id = ai ? ai->aircraft_id : -1;
+  d->step = step;
+  d->runway = (short)r->id;
+  d->decision = (short)decision;
+  d->reserved = 0;
+}
+
+/* Runway direction an aircraft needs, or -1 if it can use either. */
+static int required_direction(const aircraft_info *ai)
+{
+  if (ai->aircraft_type == COMMERCIAL)
+    return NORTH;
+  if (ai->aircraft_type == CARGO)
+    return SOUTH;
+  return -1;
+}
+
+static int direction_compatible(const aircraft_info *ai)
+{
+  int dir = required_direction(ai);
+
+  return dir < 0 || dir == ai->runway->queue_direction;
+}
+
+/* Admission order: emergencies in the second half of their timeout
+ * first, then fuel-critical aircraft, then the other emergencies, then
+ * aircraft that can use the runway in its current direction, then
+ * arrival order.  A stream of fuel-critical aircraft can hold an
+ * emergency back for half of config.emergency_timeout at most.
+ */
+static int wait_queue_before(const aircraft_info *a, const aircraft_info *b)
+{
+  if (a->emergency_urgent != b->emergency_urgent)
+    return a->emergency_urgent;
+  if (a->fuel_critical != b->fuel_critical)
+    return a->fuel_critical;
+  if ((a->aircraft_type == EMERGENCY) != (b->aircraft_type == EMERGENCY))
+    return a->aircraft_type == EMERGENCY;
+  if (direction_compatible(a) != direction_compatible(b))
+    return direction_compatible(a);
+  return a->aircraft_id < b->aircraft_id;
+}
+
+/*** Scheduling policies ***/
+
+/* A scheduling policy decides which waiting aircraft a controller admits
+ * next: on_arrival is called as an aircraft joins a wait queue and
+ * before orders the queue, whose top is the next candidate.  The rules
+ * themselves (capacity, separation, directions, breaks, the
+ * direction-limit turn and the planner) are the same under every policy,
+ * and urgent emergencies, fuel-critical aircraft and emergencies always
+ * go first, in the order of wait_queue_before().
+ */
+typedef struct
+{
+  const char *name;
+  void (*on_arrival)(aircraft_info *ai);  /* NULL if not needed */
+  int (*before)(const aircraft_info *a, const aircraft_info *b);
+} sched_policy;
+
+/* Safety first, then the policy's key, then arrival order. */
+static int sched_key_before(const aircraft_info *a, const aircraft_info *b)
+{
+  if (a->emergency_urgent != b->emergency_urgent)
+    return a->emergency_urgent;
+  if (a->fuel_critical != b->fuel_critical)
+    return a->fuel_critical;
+  if ((a->aircraft_type == EMERGENCY) != (b->aircraft_type == EMERGENCY))
+    return a->aircraft_type == EMERGENCY;
+  if (a->sched_key != b->sched_key)
+    return a->sched_key < b->sched_key;
+  return a->aircraft_id < b->aircraft_id;
+}
+
+/* FIFO: in the order the aircraft joined the queue. */
+static void fifo_arrival(aircraft_info *ai)
+{
+  ai->sched_key = ai->times[LIFE_ENQUEUE];
+}
+
+/* Shortest runway time first. */
+static void srtf_arrival(aircraft_info *ai)
+{
+  ai->sched_key = ai->runway_time;
+}
+
+/* Earliest deadline first: the fuel deadline, and for emergencies the
+ * end of their emergency timeout.
+ */
+static void edf_arrival(aircraft_info *ai)
+{
+  if (ai->aircraft_type == EMERGENCY)
+    ai->sched_key = ai->times[LIFE_ENQUEUE] + (sim_time_t)config.emergency_timeout * NSEC_PER_SEC;
+  else
+    ai->sched_key = ai->fuel_deadline;
+}
+
+/* The first entry is the default. */
+static const sched_policy policies[] = {
+  { "baseline", NULL,          wait_queue_before },
+  { "fifo",     fifo_arrival,  sched_key_before },
+  { "srtf",     srtf_arrival,  sched_key_before },
+  { "edf",      edf_arrival,   sched_key_before },
+};
+
+#define POLICIES (int)(sizeof(policies) / sizeof(policies[0]))
+
+static const sched_policy *policy = &policies[0];   /* set by --policy */
+
+static void runways_init()
+{
+  int i;
+
+  runways = calloc(runway_count, sizeof(*runways));
+  if (runways == NULL)
+  {
+    printf("runway: out of memory allocating runways\n");
+    exit(1);
+  }
+  for (i = 0; i < runway_count; i++)
+  {
+    runway_info *r = &runways[i];
+
+    r->id = i;
+    if (runway_count > 1)
+      snprintf(r->label, sizeof(r->label), " [runway %d]", i);
+    r->state = (runway_word)NORTH << RUNWAY_DIRECTION;
+    pthread_mutex_init(&r->mutex, NULL);
+    r->wait_queue.slot = HEAP_QUEUE;
+    r->wait_queue.before = policy->before;
+    r->fuel_heap.slot = HEAP_FUEL;
+    r->fuel_heap.before = fuel_deadline_before;
+    r->urgent_heap.slot = HEAP_URGENT;
+    r->urgent_heap.before = urgent_deadline_before;
+    r->watchdog_heap.slot = HEAP_WATCHDOG;
+    r->watchdog_heap.before = watchdog_due_before;
+    r->queue_direction = NORTH;
+    r->plan_until = SIM_FOREVER;
+    r->last_decision = -1;
+    r->last_decision_aircraft = -1;
+    pthread_mutex_init(&r->controller_mutex, NULL);
+    if (schedule_mode == SCHEDULE_REPLAY)
+    {
+      r->replay_next = replay_offsets[i];
+      r->replay_end = replay_offsets[i + 1];
+    }
+  }
+}
+
+static void runways_destroy()
+{
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+  {
+    pthread_mutex_destroy(&runways[i].mutex);
+    pthread_mutex_destroy(&runways[i].controller_mutex);
+    free(runways[i].wait_queue.items);
+    free(runways[i].fuel_heap.items);
+    free(runways[i].urgent_heap.items);
+    free(runways[i].watchdog_heap.items);
+    free(runways[i].waits[COMMERCIAL].items);
+    free(runways[i].waits[CARGO].items);
+    free(runways[i].waits[EMERGENCY].items);
+    free(runways[i].decisions);
+  }
+  free(runways);
+  runways = NULL;
+}
+
+/* Fuel reserves come from a splitmix64 generator rather than rand(), so
+ * they are fully determined by fuel_seed and every --trials replica can
+ * have its own stream.
+ */
+static unsigned long long rng_state;
+
+static void rng_seed(unsigned long long seed)
+{
+  rng_state = seed;
+}
+
+static unsigned long long rng_next()
+{
+  unsigned long long z = (rng_state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Assign random fuel reserve between config.fuel_min and config.fuel_max
+ * whole seconds, in ns.
+ */
+static sim_time_t random_fuel()
+{
+  return (config.fuel_min + (sim_time_t)(rng_next() % (config.fuel_max - config.fuel_min + 1)))
+         * NSEC_PER_SEC;
+}
+
+/* A uniform double in [0, 1) from the top 53 bits of the generator. */
+static double rng_uniform()
+{
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*** Synthetic workload ***/
+
+/* --generate=SPEC plays a generated scenario instead of a file.  SPEC is
+ * a comma separated list of key=value settings, all optional:
+ *
+ *   n=N            aircraft to generate
+ *   rate=R         mean arrivals per second
+ *   arrivals=P     poisson, or bursty: a Poisson process whose rate is
+ *                  burst=F times higher during bursts of mean length
+ *                  burst-len=S seconds, separated by calm periods of mean
+ *                  length calm-len=S seconds; the overall mean is still R
+ *   mix=C:G:E      relative weights of commercial, cargo and emergency
+ *   runway=D       runway time distribution
+ *   fuel=D         fuel reserve distribution
+ *
+ * A distribution D is const:X, uniform:A:B, exp:MEAN or normal:MEAN:SD in
+ * seconds, kept to the ns.  Draws come from the same generator as the
+ * fuel reserves, so --seed reproduces a generated scenario exactly.
+ */
+#define DIST_CONST   0
+#define DIST_UNIFORM 1
+#define DIST_EXP     2
+#define DIST_NORMAL  3
+#define DIST_FUEL    4   /* random_fuel(), the default for fuel */
+
+typedef struct
+{
+  int kind;                 /* DIST_* */
+  double a, b;
+} distribution;
+
+typedef struct
+{
+  long count;               /* aircraft to generate */
+  double rate;              /* mean arrivals per second */
+  int bursty;
+  double burst_factor;      /* burst rate over calm rate */
+  double burst_len;         /* mean burst length in seconds */
+  double calm_len;          /* mean calm period in seconds */
+  double mix[3];            /* cumulative type weights, mix[2] is the total */
+  distribution runway;
+  distribution fuel;
+} workload_spec;
+
+static workload_spec workload = {
+  1000, 0.2, 0, 5.0, 60.0, 240.0, { 45.0, 90.0, 100.0 },
+  { DIST_UNIFORM, 2.0, 10.0 }, { DIST_FUEL, 0.0, 0.0 }
+};
+static int generate = 0;                 /* set by --generate */
+
+/* Parse a distribution, e.g. "uniform:2:10".  Returns 0 on success. */
+static int parse_distribution(const char *s, distribution *d)
+{
+  char kind[16];
+  int n;
+
+  if (sscanf(s, "%15[a-z]:%lf:%lf%n", kind, &d->a, &d->b, &n) == 3 && s[n] == '\0')
+  {
+    if (strcmp(kind, "uniform") == 0 && d->a <= d->b)
+      d->kind = DIST_UNIFORM;
+    else if (strcmp(kind, "normal") == 0 && d->b >= 0)
+      d->kind = DIST_NORMAL;
+    else
+      return -1;
+    return 0;
+  }
+  if (sscanf(s, "%15[a-z]:%lf%n", kind, &d->a, &n) == 2 && s[n] == '\0')
+  {
+    d->b = 0;
+    if (strcmp(kind, "const") == 0)
+      d->kind = DIST_CONST;
+    else if (strcmp(kind, "exp") == 0 && d->a > 0)
+      d->kind = DIST_EXP;
+    else
+      return -1;
+    return 0;
+  }
+  return -1;
+}
+
+/*
+ * Function: parse_workload
+ * Parameters: spec - the argument of --generate
+ * Returns: 0 on success, EINVAL after printing what is wrong
+ * Description: Fill in the global workload from spec; settings that are
+ * not given keep their defaults.
+ */
+static int parse_workload(char *spec)
+{
+  char *item, *value;
+  double c, g, e;
+  int n;
+
+  for (item = strtok(spec, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    value = strchr(item, '=');
+    if (value == NULL)
+    {
+      printf("runway: --generate setting '%s' has no value\n", item);
+      return EINVAL;
+    }
+    *value++ = '\0';
+
+    if (strcmp(item, "n") == 0 && (workload.count = atol(value)) > 0 && workload.count <= INT_MAX)
+      continue;
+    if (strcmp(item, "rate") == 0 && (workload.rate = atof(value)) > 0)
+      continue;
+    if (strcmp(item, "arrivals") == 0 && strcmp(value, "poisson") == 0)
+    {
+      workload.bursty = 0;
+      continue;
+    }
+    if (strcmp(item, "arrivals") == 0 && strcmp(value, "bursty") == 0)
+    {
+      workload.bursty = 1;
+      continue;
+    }
+    if (strcmp(item, "burst") == 0 && (workload.burst_factor = atof(value)) >= 1)
+      continue;
+    if (strcmp(item, "burst-len") == 0 && (workload.burst_len = atof(value)) > 0)
+      continue;
+    if (strcmp(item, "calm-len") == 0 && (workload.calm_len = atof(value)) > 0)
+      continue;
+    if (strcmp(item, "mix") == 0 && sscanf(value, "%lf:%lf:%lf%n", &c, &g, &e, &n) == 3 &&
+        value[n] == '\0' && c >= 0 && g >= 0 && e >= 0 && c + g + e > 0)
+    {
+      workload.mix[0] = c;
+      workload.mix[1] = c + g;
+      workload.mix[2] = c + g + e;
+      continue;
+    }
+    if (strcmp(item, "runway") == 0 && parse_distribution(value, &workload.runway) == 0)
+      continue;
+    if (strcmp(item, "fuel") == 0 && parse_distribution(value, &workload.fuel) == 0)
+      continue;
+
+    printf("runway: bad --generate setting %s=%s\n", item, value);
+    return EINVAL;
+  }
+  return 0;
+}
+
+/* Draw from d in ns, at least min seconds. */
+static sim_time_t sample_distribution(const distribution *d, int min)
+{
+  double x, u;
+
+  switch (d->kind)
+  {
+    case DIST_UNIFORM:
+      x = d->a + (d->b - d->a) * rng_uniform();
+      break;
+    case DIST_EXP:
+      x = -d->a * log(1.0 - rng_uniform());
+      break;
+    case DIST_NORMAL:
+      /* Box-Muller; only one of the pair is used */
+      u = 1.0 - rng_uniform();
+      x = d->a + d->b * sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * rng_uniform());
+      break;
+    default:
+      x = d->a;
+      break;
+  }
+  if (x < min)
+    x = min;
+  if (x > INT_MAX)
+    x = INT_MAX;
+  return llround(x * NSEC_PER_SEC);
+}
+
+/* Exponentially distributed time with the given mean. */
+static double sample_exponential(double mean)
+{
+  return -mean * log(1.0 - rng_uniform());
+}
+
+/* Scenario input, read incrementally while the simulation runs.  Input
+ * files are mapped into memory; a text file is parsed a line at a time
+ * as the arrival loop asks for aircraft, a binary one (runway_scenario.h)
+ * is read record by record straight from the mapping.
+ */
+#define SCENARIO_TEXT      0
+#define SCENARIO_BINARY    1
+#define SCENARIO_GENERATED 2
+#define SCENARIO_STREAM    3
+
+typedef struct
+{
+  int kind;                 /* SCENARIO_* */
+  const char *name;         /* file name, for messages */
+  const char *data;         /* the mapped file, NULL if generated or empty */
+  size_t size;
+  size_t pos;               /* offset of the next line or record */
+  long line;                /* text lines read so far */
+  int version;              /* SCENARIO_VERSION* of a binary file */
+  int fuel_fixed;           /* the last aircraft's fuel came with it */
+  long generated;           /* aircraft generated so far */
+  double clock;             /* arrival time of the last one, in seconds */
+  int in_burst;
+  double phase_end;         /* when the current burst or calm period ends */
+
+  /* A stream is read into buffer as the producer sends it; data, size
+   * and pos then cover the complete lines in it.
+   */
+  int fd;
+  char *buffer;
+  size_t filled;            /* bytes in buffer */
+  size_t capacity;
+  int eof;                  /* the producer has closed the stream */
+  int wait;                 /* wait for the next line rather than give up */
+} scenario_reader;
+
+/* Generate the next aircraft of a --generate scenario into ai, fuel
+ * reserve included.  Returns 0 once workload.count aircraft are out.
+ *
+ * Arrivals are drawn in continuous time and the delay to the previous
+ * aircraft is the difference of the ns they fall in, so rounding never
+ * drifts the arrival rate away from workload.rate.
+ */
+static int workload_next(scenario_reader *sr, aircraft_info *ai)
+{
+  double previous = sr->clock;
+  double calm_rate, rate, t;
+  double p, w;
+
+  if (sr->generated == workload.count)
+    return 0;
+
+  if (!workload.bursty)
+  {
+    sr->clock += sample_exponential(1.0 / workload.rate);
+  }
+  else
+  {
+    /* Calm and burst rates are set so the long-run mean is workload.rate.
+     * The process is memoryless, so at a phase change the pending
+     * interarrival time is simply redrawn at the new rate.
+     */
+    p = workload.burst_len / (workload.burst_len + workload.calm_len);
+    calm_rate = workload.rate / (1.0 - p + workload.burst_factor * p);
+    for (;;)
+    {
+      rate = sr->in_burst ? calm_rate * workload.burst_factor : calm_rate;
+      t = sr->clock + sample_exponential(1.0 / rate);
+      if (t <= sr->phase_end)
+      {
+        sr->clock = t;
+        break;
+      }
+      sr->clock = sr->phase_end;
+      sr->in_burst = !sr->in_burst;
+      sr->phase_end += sample_exponential(sr->in_burst ? workload.burst_len : workload.calm_len);
+    }
+  }
+  ai->arrival_time = llround(sr->clock * NSEC_PER_SEC) - llround(previous * NSEC_PER_SEC);
+
+  w = rng_uniform() * workload.mix[2];
+  ai->aircraft_type = w < workload.mix[0] ? COMMERCIAL : w < workload.mix[1] ? CARGO : EMERGENCY;
+  ai->runway_time = sample_distribution(&workload.runway, 0);
+  if (workload.fuel.kind == DIST_FUEL)
+    ai->fuel_reserve = random_fuel();
+  else
+    ai->fuel_reserve = sample_distribution(&workload.fuel, 1);
+  sr->generated++;
+  return 1;
+}
+
+/* Parse up to three numbers from the line [p, end) into v, in ns: a
+ * number of seconds with up to nine decimals, "2" or "0.25".  Returns how
+ * many were found before the end of the line or something that is not a
+ * number, which for whole seconds is what sscanf("%d%d%d") returned for
+ * the line.
+ */
+static int scan_line(const char *p, const char *end, sim_time_t v[3])
+{
+  unsigned long long x;
+  sim_time_t scale;
+  int n, negative;
+
+  for (n = 0; n < 3; n++)
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+      p++;
+    negative = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+      negative = *p++ == '-';
+    if (p == end || (unsigned char)(*p - '0') > 9)
+      break;
+    for (x = 0; p < end && (unsigned char)(*p - '0') <= 9; p++)
+      x = x * 10 + (unsigned char)(*p - '0');
+    x *= NSEC_PER_SEC;
+    if (p < end && *p == '.')
+    {
+      for (p++, scale = NSEC_PER_SEC / 10; p < end && (unsigned char)(*p - '0') <= 9; p++, scale /= 10)
+        x += (unsigned char)(*p - '0') * scale;
+    }
+    v[n] = negative ? -(sim_time_t)x : (sim_time_t)x;
+  }
+  return n;
+}
+
+/* Find the next aircraft line of a text scenario, skipping comment
+ * lines and empty lines as the original fgets() loop did, and lines
+ * whose aircraft type is not a whole number.  Returns 1 with the line's
+ * numbers in v, in ns, 0 at the end of the file.
+ */
+static int scenario_text_line(scenario_reader *sr, sim_time_t v[3])
+{
+  const char *p, *end, *eol;
+
+  while (sr->pos < sr->size)
+  {
+    p = sr->data + sr->pos;
+    end = sr->data + sr->size;
+    eol = memchr(p, '\n', end - p);
+    if (eol == NULL)
+      eol = end;
+    sr->pos = eol - sr->data + (eol < end);
+    sr->line++;
+
+    if (p == eol || *p == '#' || *p == '\r')
+      continue;
+    if (scan_line(p, eol, v) == 3 && v[0] % NSEC_PER_SEC == 0)
+      return 1;
+  }
+  return 0;
+}
+
+#define STREAM_BUFFER 65536         /* first size of a stream's buffer */
+
+/* Whether filename names a stream rather than a file that can be mapped:
+ * "-" for stdin, a FIFO, a character device or a Unix domain socket.
+ */
+static int scenario_is_stream(const char *filename)
+{
+  struct stat st;
+
+  if (filename == NULL)
+    return 0;
+  if (strcmp(filename, "-") == 0)
+    return 1;
+  return stat(filename, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) || S_ISSOCK(st.st_mode));
+}
+
+/* Open the stream filename for sr.  A socket is connected to; whoever
+ * listens on it is the producer.
+ */
+static void stream_open(scenario_reader *sr, const char *filename)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+
+  sr->kind = SCENARIO_STREAM;
+  sr->fd = -1;
+  if (strcmp(filename, "-") == 0)
+  {
+    sr->fd = STDIN_FILENO;
+  }
+  else if (stat(filename, &st) == 0 && S_ISSOCK(st.st_mode))
+  {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(filename) < sizeof(addr.sun_path))
+    {
+      strcpy(addr.sun_path, filename);
+      sr->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+    if (sr->fd >= 0 && connect(sr->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      close(sr->fd);
+      sr->fd = -1;
+    }
+  }
+  else
+  {
+    sr->fd = open(filename, O_RDONLY);
+  }
+  sr->capacity = STREAM_BUFFER;
+  sr->buffer = malloc(sr->capacity);
+  if (sr->fd < 0 || sr->buffer == NULL)
+  {
+    printf("Cannot open input stream %s for reading.\n", filename);
+    exit(1);
+  }
+  sr->data = sr->buffer;
+}
+
+/* Read what the producer has sent into sr->buffer, waiting for it if
+ * sr->wait.  Returns 0 if nothing came in.
+ */
+static int stream_read(scenario_reader *sr)
+{
+  struct pollfd pfd;
+  const char *eol;
+  ssize_t n;
+
+  if (sr->pos > 0)
+  {
+    memmove(sr->buffer, sr->buffer + sr->pos, sr->filled - sr->pos);
+    sr->filled -= sr->pos;
+    sr->size -= sr->pos;
+    sr->pos = 0;
+  }
+  if (sr->filled == sr->capacity)
+  {
+    sr->capacity *= 2;
+    if ((sr->buffer = realloc(sr->buffer, sr->capacity)) == NULL)
+    {
+      printf("runway: out of memory for the input stream\n");
+      exit(1);
+    }
+  }
+  sr->data = sr->buffer;
+
+  pfd.fd = sr->fd;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, sr->wait ? -1 : 0) <= 0)
+    return 0;
+  n = read(sr->fd, sr->buffer + sr->filled, sr->capacity - sr->filled);
+  if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN))
+    sr->eof = 1;
+  if (n > 0)
+    sr->filled += n;
+
+  /* only complete lines are parsed until the stream ends */
+  eol = memrchr(sr->buffer, '\n', sr->filled);
+  sr->size = sr->eof ? sr->filled : eol != NULL ? (size_t)(eol - sr->buffer) + 1 : 0;
+  return n > 0;
+}
+
+/* The next aircraft line of a stream, like scenario_text_line().  Returns
+ * 0 at the end of the stream, or if sr->wait is not set and no complete
+ * line has come in yet.
+ */
+static int stream_line(scenario_reader *sr, sim_time_t v[3])
+{
+  while (!scenario_text_line(sr, v))
+  {
+    if (sr->eof)
+      return 0;
+    if (!stream_read(sr) && !sr->wait && !sr->eof)
+      return 0;
+  }
+  return 1;
+}
+
+/* Whether an aircraft read from a scenario can be simulated: a known
+ * type, no negative time and a fuel reserve that is not negative unless
+ * it is SCENARIO_RANDOM_FUEL.
+ */
+static int scenario_valid(long long type, sim_time_t arrival_time, sim_time_t runway_time,
+                          sim_time_t fuel_reserve)
+{
+  return type >= COMMERCIAL && type <= EMERGENCY && arrival_time >= 0 && runway_time >= 0
+         && (fuel_reserve >= 0 || fuel_reserve == SCENARIO_RANDOM_FUEL);
+}
+
+/* Decode the binary scenario record at offset pos of sr into ai. */
+static void scenario_record_read(const scenario_reader *sr, size_t pos, aircraft_info *ai)
+{
+  const scenario_record *rec;
+  const scenario_record_v1 *old;
+
+  if (sr->version == SCENARIO_VERSION_V1)
+  {
+    old = (const scenario_record_v1 *)(sr->data + pos);
+    ai->aircraft_type = old->aircraft_type;
+    ai->arrival_time = (sim_time_t)old->arrival_time * NSEC_PER_SEC;
+    ai->runway_time = (sim_time_t)old->runway_time * NSEC_PER_SEC;
+    ai->fuel_reserve = old->fuel_reserve == SCENARIO_RANDOM_FUEL
+                       ? SCENARIO_RANDOM_FUEL : (sim_time_t)old->fuel_reserve * NSEC_PER_SEC;
+  }
+  else
+  {
+    rec = (const scenario_record *)(sr->data + pos);
+    ai->aircraft_type = rec->aircraft_type;
+    ai->arrival_time = rec->arrival_time;
+    ai->runway_time = rec->runway_time;
+    ai->fuel_reserve = rec->fuel_reserve;
+  }
+}
+
+/* Called at beginning of simulation.  
+ * TODO: Create/initialize all synchronization
+ * variables and other global variables that you add.
+ * Returns the number of aircraft in the scenario, 0 for a stream.
+ */
+static int initialize(scenario_reader *sr, char *filename) 
+{
+  const scenario_header *header;
+  struct stat st;
+  long long count = 0;
+  aircraft_info rec;
+  sim_time_t v[3];
+  size_t size;
+  int fd;
+
+  /* Initialize your synchronization variables (and
+   * other variables you might use) here
+   */
+
+  runways_init();
+
+  /* seed random number generator for fuel reserves */
+  rng_seed(fuel_seed);
+
+  sr->kind = SCENARIO_TEXT;
+  sr->name = filename;
+  sr->data = NULL;
+  sr->size = 0;
+  sr->pos = 0;
+  sr->line = 0;
+  sr->version = SCENARIO_VERSION;
+  sr->fuel_fixed = 0;
+  sr->generated = 0;
+  sr->clock = 0.0;
+  sr->in_burst = 0;
+  sr->phase_end = 0.0;
+  sr->fd = -1;
+  sr->buffer = NULL;
+  sr->filled = 0;
+  sr->eof = 0;
+  sr->wait = 1;
+  if (generate)
+  {
+    sr->kind = SCENARIO_GENERATED;
+    if (workload.bursty)
+      sr->phase_end = sample_exponential(workload.calm_len);
+    return (int)workload.count;
+  }
+
+  /* A stream is read as its lines come in; how many there will be is not
+   * known.
+   */
+  if (scenario_is_stream(filename))
+  {
+    stream_open(sr, filename);
+    return 0;
+  }
+
+  /* Map the data file.  Aircraft are read from it one at a time by
+   * scenario_next() as the simulation plays; here we only count them.
+   */
+  if ((fd = open(filename, O_RDONLY)) < 0 || fstat(fd, &st) != 0) 
+  {
+    printf("Cannot open input file %s for reading.\n", filename);
+    exit(1);
+  }
+  sr->size = st.st_size;
+  if (sr->size > 0)
+  {
+    sr->data = mmap(NULL, sr->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (sr->data == MAP_FAILED)
+    {
+      printf("Cannot map input file %s: %s\n", filename, strerror(errno));
+      exit(1);
+    }
+    madvise((void *)sr->data, sr->size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  /* Version 1 files, in whole seconds, are still read */
+  header = (const scenario_header *)sr->data;
+  if (sr->size >= sizeof(*header) && memcmp(header->magic, SCENARIO_MAGIC, sizeof(SCENARIO_MAGIC)) == 0)
+  {
+    sr->version = header->version;
+    size = sr->version == SCENARIO_VERSION_V1 ? sizeof(scenario_record_v1) : sizeof(scenario_record);
+    if ((sr->version != SCENARIO_VERSION && sr->version != SCENARIO_VERSION_V1) ||
+        header->record_size != (int)size || header->count < 0 || header->count > INT_MAX ||
+        (sr->size - sizeof(*header)) / size != (size_t)header->count)
+    {
+      printf("Input file %s is not a version %d or %d binary scenario of this machine.\n",
+             filename, SCENARIO_VERSION_V1, SCENARIO_VERSION);
+      exit(1);
+    }
+    sr->kind = SCENARIO_BINARY;
+    sr->pos = sizeof(*header);
+    for (count = 0; count < header->count; count++)
+    {
+      scenario_record_read(sr, sr->pos + count * size, &rec);
+      if (!scenario_valid(rec.aircraft_type, rec.arrival_time, rec.runway_time, rec.fuel_reserve))
+      {
+        printf("Input file %s is damaged at record %lld.\n", filename, count);
+        exit(1);
+      }
+    }
+    return (int)header->count;
+  }
+
+  while (scenario_text_line(sr, v))
+  {
+    if (!scenario_valid(v[0] / NSEC_PER_SEC, v[1], v[2], SCENARIO_RANDOM_FUEL))
+    {
+      printf("Input file %s is damaged at line %ld.\n", filename, sr->line);
+      exit(1);
+    }
+    count++;
+  }
+  sr->pos = 0;
+  sr->line = 0;
+  return count > INT_MAX ? INT_MAX : (int)count;
+}
+
+/* Read the next aircraft of the scenario into ai, or generate it.
+ * Returns 1 on success, 0 at the end of the scenario.
+ */
+static int scenario_next(scenario_reader *sr, aircraft_info *ai)
+{
+  int found = 0;
+  sim_time_t v[3];
+
+  sr->fuel_fixed = 1;
+  if (sr->kind == SCENARIO_GENERATED)
+  {
+    found = workload_next(sr, ai);
+  }
+  else if (sr->kind == SCENARIO_BINARY)
+  {
+    if (sr->pos < sr->size)
+    {
+      scenario_record_read(sr, sr->pos, ai);
+      sr->pos += sr->version == SCENARIO_VERSION_V1 ? sizeof(scenario_record_v1) : sizeof(scenario_record);
+      found = 1;
+    }
+  }
+  else if (sr->kind == SCENARIO_STREAM ? stream_line(sr, v) : scenario_text_line(sr, v))
+  {
+    /* files were checked by initialize(), a stream only shows up now */
+    if (!scenario_valid(v[0] / NSEC_PER_SEC, v[1], v[2], SCENARIO_RANDOM_FUEL))
+    {
+      printf("Input stream %s is damaged at line %ld.\n", sr->name, sr->line);
+      exit(1);
+    }
+    ai->aircraft_type = (int)(v[0] / NSEC_PER_SEC);
+    ai->arrival_time = v[1];
+    ai->runway_time = v[2];
+    ai->fuel_reserve = SCENARIO_RANDOM_FUEL;
+    found = 1;
+  }
+  if (!found)
+    return 0;
+
+  if (ai->fuel_reserve == SCENARIO_RANDOM_FUEL)
+  {
+    ai->fuel_reserve = random_fuel();
+    sr->fuel_fixed = 0;
+  }
+  aircraft_reset(ai);
+  return 1;
+}
+
+static void scenario_close(scenario_reader *sr)
+{
+  if (sr->kind == SCENARIO_STREAM)
+  {
+    if (sr->fd != STDIN_FILENO)
+      close(sr->fd);
+    free(sr->buffer);
+  }
+  else if (sr->data != NULL)
+  {
+    munmap((void *)sr->data, sr->size);
+  }
+  sr->data = NULL;
+}
+
+/* Aircraft released and not yet on a runway. */
+static int backlog()
+{
+  int n = __atomic_load_n(&arrivals_pending, __ATOMIC_RELAXED);
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+    n += __atomic_load_n(&runways[i].queued, __ATOMIC_RELAXED);
+  return n;
+}
+
+/* Before the arrival loop reads more of a stream, wait until fewer than
+ * config.backlog aircraft are waiting.  Until then the producer's writes
+ * fill the pipe or socket buffer and then block, so a producer that is
+ * faster than the runways is held back instead of the wait queues
+ * growing without bound.
+ */
+static void backlog_wait()
+{
+  sim_time_t start;
+
+  pthread_mutex_lock(&Mutex_BACKLOG);
+  __atomic_store_n(&backlog_waiting, 1, __ATOMIC_SEQ_CST);
+  if (backlog() >= config.backlog)
+  {
+    start = sim_now();
+    backlog_stalls++;
+    while (backlog() >= config.backlog)
+      sim_cond_wait(&Cond_BACKLOG, &Mutex_BACKLOG);
+    backlog_stalled += sim_now() - start;
+  }
+  __atomic_store_n(&backlog_waiting, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&Mutex_BACKLOG);
+}
+
+/* Wake the arrival loop if it waits in backlog_wait(); called after an
+ * aircraft has left the wait queues.
+ */
+static void backlog_notify()
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(&backlog_waiting, __ATOMIC_SEQ_CST))
+    return;
+  pthread_mutex_lock(&Mutex_BACKLOG);
+  sim_cond_signal(&Cond_BACKLOG);
+  pthread_mutex_unlock(&Mutex_BACKLOG);
+}
+
+/* The arrival loop reads the scenario FORECAST_AIRCRAFT aircraft ahead of
+ * the clock so the direction planner knows what is coming.  The queue is
+ * private to the arrival loop; only the first arrival for each direction
+ * is published, in forecast_due, and the first one overall in
+ * forecast_next.
+ */
+#define FORECAST_AIRCRAFT 64
+
+typedef struct
+{
+  scenario_reader *scenario;
+  aircraft_info *items[FORECAST_AIRCRAFT];
+  sim_time_t due[FORECAST_AIRCRAFT];     /* when each one arrives */
+  int head;
+  int count;
+  sim_time_t last_due;                   /* arrival time of the last one read */
+} forecast_queue;
+
+/* Read ahead until the queue is full, then publish the first arrival in
+ * each direction and the first one overall.  A stream is only read as
+ * far as its producer has sent and while the aircraft waiting and read
+ * ahead stay below config.backlog, unless block is set and the queue is
+ * empty.  Its aircraft arrive their delay after the previous one or after
+ * they were read, whichever is later.
+ */
+static void forecast_fill(forecast_queue *fq, int block)
+{
+  sim_time_t due[2] = { SIM_FOREVER, SIM_FOREVER };
+  sim_time_t runway_time[2] = { 0, 0 };
+  aircraft_info *ai;
+  int i, k, dir;
+
+  while (fq->count < FORECAST_AIRCRAFT
+         && (fq->scenario->kind != SCENARIO_STREAM || (block && fq->count == 0)
+             || backlog() + fq->count < config.backlog))
+  {
+    ai = aircraft_alloc();
+    fq->scenario->wait = block && fq->count == 0;
+    if (!scenario_next(fq->scenario, ai))
+    {
+      aircraft_release(ai);
+      break;
+    }
+    k = (fq->head + fq->count++) % FORECAST_AIRCRAFT;
+    if (fq->scenario->kind == SCENARIO_STREAM && fq->last_due < sim_now())
+      fq->last_due = sim_now();
+    fq->last_due += ai->arrival_time;
+    fq->items[k] = ai;
+    fq->due[k] = fq->last_due;
+  }
+
+  for (i = 0; i < fq->count; i++)
+  {
+    k = (fq->head + i) % FORECAST_AIRCRAFT;
+    dir = required_direction(fq->items[k]);
+    if (dir >= 0 && due[dir] == SIM_FOREVER)
+    {
+      due[dir] = fq->due[k];
+      runway_time[dir] = fq->items[k]->runway_time;
+    }
+  }
+  pthread_mutex_lock(&Mutex_FORECAST);
+  for (dir = 0; dir < 2; dir++)
+  {
+    forecast_due[dir] = due[dir];
+    forecast_runway_time[dir] = runway_time[dir];
+  }
+  if (fq->count > 0)
+    forecast_next = fq->due[fq->head];
+  else
+    forecast_next = fq->scenario->kind == SCENARIO_STREAM && !fq->scenario->eof ? 0 : SIM_FOREVER;
+  pthread_mutex_unlock(&Mutex_FORECAST);
+}
+
+static void forecast_init(forecast_queue *fq, scenario_reader *sr)
+{
+  fq->scenario = sr;
+  fq->head = 0;
+  fq->count = 0;
+  fq->last_due = sim_now();
+  forecast_fill(fq, 1);
+}
+
+/* The next aircraft to arrive, still in the forecast, or NULL at the end.
+ * Once a stream's forecast runs dry, this waits for the backlog and then
+ * for the producer.
+ */
+static aircraft_info *forecast_peek(forecast_queue *fq)
+{
+  if (fq->count == 0 && fq->scenario->kind == SCENARIO_STREAM && !fq->scenario->eof)
+  {
+    backlog_wait();
+    forecast_fill(fq, 1);
+  }
+  return fq->count ? fq->items[fq->head] : NULL;
+}
+
+/* When the next aircraft arrives. */
+static sim_time_t forecast_due_next(forecast_queue *fq)
+{
+  return fq->due[fq->head];
+}
+
+/* Take the next aircraft out of the forecast once it has arrived. */
+static void forecast_pop(forecast_queue *fq)
+{
+  fq->head = (fq->head + 1) % FORECAST_AIRCRAFT;
+  fq->count--;
+  forecast_fill(fq, 0);
+}
+
+/*** Event log ***/
+
+/* Simulation messages are not printed by the threads that cause them.
+ * Each thread writes fixed-size records into a ring of its own and a
+ * background writer thread drains the rings, puts the records back in
+ * the order they were logged (every record takes a global sequence
+ * number) and either formats them as the usual text on stdout or writes
+ * them unformatted to the file given with --binary-log, see runway_log.h.
+ * The binary log also carries trace events for runway-verify.
+ *
+ * A ring has one producer, its owning thread, and one consumer, the
+ * writer, so pushing is a plain store and a release of the head index.
+ * When a ring is full its owner waits for the writer instead of dropping
+ * records.  An aircraft thread hands its ring back when it exits and the
+ * next thread reuses it.
+ */
+#define LOG_RING_RECORDS 256       /* records per ring, a power of two */
+#define LOG_WRITER_PERIOD 5000000  /* ns between the writer's rounds */
+
+#define LOG_TEXT   0               /* formatted on stdout */
+#define LOG_BINARY 1               /* log_record structs in log_binary_path */
+#define LOG_OFF    2               /* nothing is logged */
+
+typedef struct log_ring
+{
+  struct log_ring *next;        /* every ring, scanned by the writer */
+  struct log_ring *free_next;   /* rings no thread owns */
+  unsigned long head;           /* next slot to fill, written by the owner */
+  unsigned long tail;           /* next slot to drain, written by the writer */
+  log_record records[LOG_RING_RECORDS];
+} log_ring;
+
+static int log_mode = LOG_TEXT;          /* set by --binary-log */
+static char *log_binary_path = NULL;
+static FILE *log_out = NULL;
+
+static pthread_mutex_t Mutex_LOG = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Cond_LOG;         /* wakes the writer, on CLOCK_MONOTONIC */
+static pthread_cond_t Cond_LOG_FLUSHED = PTHREAD_COND_INITIALIZER; /* log_flush() waiters */
+static pthread_cond_t Cond_LOG_SPACE = PTHREAD_COND_INITIALIZER;   /* log_push() on a full ring */
+static pthread_t log_writer_tid;
+static int log_writer_idle = 0;          /* writer is waiting on Cond_LOG */
+static int log_stopping = 0;
+static int log_flush_waiters = 0;
+static int log_space_waiters = 0;
+static long log_full_waits = 0;          /* times a thread found its ring full */
+static unsigned long long log_next_seq = 0;
+static unsigned long long log_emitted = 0;  /* records written out, all below this seq */
+
+static log_ring *log_rings = NULL;       /* under Mutex_LOG; read by the writer */
+static log_ring *log_free = NULL;
+static __thread log_ring *log_local = NULL;
+
+/* Records the writer has drained but cannot write yet because one with a
+ * lower sequence number is still missing.  Min-heap on seq.
+ */
+static log_record *log_pending = NULL;
+static int log_pending_count = 0;
+static int log_pending_capacity = 0;
+
+static log_ring *log_acquire()
+{
+  log_ring *ring;
+
+  pthread_mutex_lock(&Mutex_LOG);
+  if ((ring = log_free) != NULL)
+  {
+    log_free = ring->free_next;
+  }
+  else
+  {
+    if ((ring = calloc(1, sizeof(*ring))) == NULL)
+    {
+      printf("runway: out of memory allocating a log ring\n");
+      exit(1);
+    }
+    ring->next = log_rings;
+    __atomic_store_n(&log_rings, ring, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&Mutex_LOG);
+  return ring;
+}
+
+/* Hand the calling thread's ring back before the thread exits. */
+static void log_detach()
+{
+  if (log_local == NULL)
+    return;
+  pthread_mutex_lock(&Mutex_LOG);
+  log_local->free_next = log_free;
+  log_free = log_local;
+  pthread_mutex_unlock(&Mutex_LOG);
+  log_local = NULL;
+}
+
+/* The writer drains the rings every LOG_WRITER_PERIOD, or sooner when a
+ * ring is half full.  Like notify_controller(), it announces that it is
+ * idle before its last look at the rings, so the mutex is only taken
+ * when it sleeps.
+ */
+static void log_wake_writer()
+{
+  if (__atomic_load_n(&log_writer_idle, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&Mutex_LOG);
+    pthread_cond_signal(&Cond_LOG);
+    pthread_mutex_unlock(&Mutex_LOG);
+  }
+}
+
+/* Append rec to the calling thread's ring, stamped with its sequence
+ * number and time.  If the ring is full the thread sleeps on
+ * Cond_LOG_SPACE until the writer has drained it, so the log is never
+ * cut short and a slow writer does not have to compete with spinning
+ * producers for the CPU.
+ */
+static void log_push(log_record *rec)
+{
+  log_ring *ring = log_local;
+  unsigned long head;
+
+  if (ring == NULL)
+    ring = log_local = log_acquire();
+
+  head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == LOG_RING_RECORDS)
+  {
+    pthread_mutex_lock(&Mutex_LOG);
+    log_full_waits++;
+    log_space_waiters++;
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == LOG_RING_RECORDS)
+    {
+      pthread_cond_signal(&Cond_LOG);
+      pthread_cond_wait(&Cond_LOG_SPACE, &Mutex_LOG);
+    }
+    log_space_waiters--;
+    pthread_mutex_unlock(&Mutex_LOG);
+  }
+  rec->seq = __atomic_fetch_add(&log_next_seq, 1, __ATOMIC_RELAXED);
+  rec->time = sim_now();
+  ring->records[head % LOG_RING_RECORDS] = *rec;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+  if (head + 1 - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) >= LOG_RING_RECORDS / 2)
+    log_wake_writer();
+}
+
+/* Log an event.  Fields that do not apply are -1 or 0. */
+static void log_event(int event, int runway, int aircraft_id, int aircraft_type,
+                      int direction, int value)
+{
+  log_record rec;
+
+  if (log_mode == LOG_OFF)
+    return;
+  memset(&rec, 0, sizeof(rec));
+  rec.event = (short)event;
+  rec.runway = (short)runway;
+  rec.aircraft_id = aircraft_id;
+  rec.aircraft_type = (short)aircraft_type;
+  rec.direction = (short)direction;
+  rec.value = value;
+  log_push(&rec);
+}
+
+/* Log an event of runway r, and of aircraft ai if not NULL, together with
+ * the runway's direction and occupancy from the state word w.  Trace
+ * events only go to the binary log.
+ */
+static void log_runway(int event, runway_info *r, aircraft_info *ai, runway_word w)
+{
+  log_record rec;
+
+  if (log_mode == LOG_OFF || (LOG_TRACE_ONLY(event) && log_mode != LOG_BINARY))
+    return;
+  memset(&rec, 0, sizeof(rec));
+  rec.event = (short)event;
+  rec.runway = (short)r->id;
+  rec.aircraft_id = ai ? ai->aircraft_id : -1;
+  rec.aircraft_type = (short)(ai ? ai->aircraft_type : -1);
+  rec.direction = (short)runway_get(w, RUNWAY_DIRECTION);
+  rec.total = (unsigned char)runway_get(w, RUNWAY_TOTAL);
+  rec.commercial = (unsigned char)runway_get(w, RUNWAY_COMMERCIAL);
+  rec.cargo = (unsigned char)runway_get(w, RUNWAY_CARGO);
+  rec.emergency = (unsigned char)runway_get(w, RUNWAY_EMERGENCY);
+  log_push(&rec);
+}
+
+/* A time in ns as the ms a log record holds. */
+static int log_ms(sim_time_t t)
+{
+  t /= NSEC_PER_SEC / 1000;
+  return t > INT_MAX ? INT_MAX : (int)t;
+}
+
+/* Write ms as seconds into buf: whole seconds as before, otherwise with
+ * the trailing zeros of the ms dropped.
+ */
+static const char *log_seconds(char *buf, size_t size, int ms)
+{
+  int n;
+
+  if (ms % 1000 == 0)
+  {
+    snprintf(buf, size, "%d", ms / 1000);
+    return buf;
+  }
+  n = snprintf(buf, size, "%d.%03d", ms / 1000, ms % 1000);
+  while (n > 0 && buf[n - 1] == '0')
+    buf[--n] = '\0';
+  return buf;
+}
+
+static const char *log_direction(int direction)
+{
+  return direction == NORTH ? "NORTH" : "SOUTH";
+}
+
+/* Print rec as the message the simulator has always printed. */
+static void log_format(FILE *out, const log_record *rec)
+{
+  static const char *who[3] = { "Commercial", "Cargo", "EMERGENCY" };
+  const char *label = rec->runway >= 0 ? runways[rec->runway].label : "";
+  char seconds[16];
+
+  switch (rec->event)
+  {
+    case LOG_CONTROLLER_ARRIVED:
+      fprintf(out, "The air traffic controller arrived and is beginning operations%s\n", label);
+      break;
+    case LOG_BREAK:
+      fprintf(out, "The air traffic controller is taking a break now.%s\n", label);
+      break;
+    case LOG_SWITCHING:
+      fprintf(out, "Switching runway direction from %s to %s%s\n",
+              log_direction(rec->direction),
+              log_direction(rec->direction == NORTH ? SOUTH : NORTH), label);
+      break;
+    case LOG_SWITCHED:
+      fprintf(out, "Runway direction switched to %s%s\n", log_direction(rec->direction), label);
+      break;
+    case LOG_FUEL_OUT:
+      fprintf(out, "EMERGENCY: %s Aircraft %d has ran out of reserved fuel and will land imminently!%s\n",
+              who[rec->aircraft_type], rec->aircraft_id, label);
+      break;
+    case LOG_ON_RUNWAY:
+      fprintf(out, "%s aircraft %d (fuel: %ss) is now on the runway (direction: %s)%s\n",
+              who[rec->aircraft_type], rec->aircraft_id,
+              log_seconds(seconds, sizeof(seconds), rec->value),
+              log_direction(rec->direction), label);
+      break;
+    case LOG_BEGIN:
+      fprintf(out, "%s aircraft %d begins runway operations for %s seconds\n",
+              who[rec->aircraft_type], rec->aircraft_id,
+              log_seconds(seconds, sizeof(seconds), rec->value));
+      break;
+    case LOG_COMPLETE:
+      fprintf(out, "%s aircraft %d completes runway operations and prepares to depart\n",
+              who[rec->aircraft_type], rec->aircraft_id);
+      break;
+    case LOG_CLEARED:
+      fprintf(out, "%s aircraft %d has cleared the runway\n",
+              who[rec->aircraft_type], rec->aircraft_id);
+      break;
+    case LOG_WATCHDOG:
+      fprintf(out, "\n=== Watchdog: ");
+      if (rec->value > 0)
+        fprintf(out, "no progress for %d s", rec->value);
+      else
+        fprintf(out, "snapshot on SIGUSR1");
+      fprintf(out, " at %s s, %d aircraft cleared ===\n",
+              log_seconds(seconds, sizeof(seconds), log_ms(rec->time)), rec->aircraft_id);
+      break;
+    case LOG_WATCH_ARRIVALS:
+      fprintf(out, "Aircraft: %d in flight, %d released and not yet queued\n",
+              rec->value, rec->aircraft_id);
+      if (rec->extra == WATCH_BACKLOG)
+        fprintf(out, "Arrival loop: waits on Cond_BACKLOG for fewer than %d aircraft waiting\n",
+                config.backlog);
+      else if (rec->extra == WATCH_STREAM)
+        fprintf(out, "Arrival loop: waits for the stream\n");
+      else
+        fprintf(out, "Arrival loop: releases aircraft at their arrival times\n");
+      break;
+    case LOG_WATCH_RUNWAY:
+      fprintf(out, "Runway %d: %s, %d in a row, %d on the runway (commercial %d, cargo %d, "
+              "emergency %d), %d since the break\n", rec->runway, log_direction(rec->direction),
+              rec->value, rec->total, rec->commercial, rec->cargo, rec->emergency, rec->extra);
+      break;
+    case LOG_WATCH_CONTROLLER:
+      if (rec->extra == WATCH_PAUSED)
+        fprintf(out, "  controller: on a break or switching direction, sleeps on the clock\n");
+      else if (rec->extra == WATCH_IDLE)
+        fprintf(out, "  controller: waits on controller_cond, %d events pending\n", rec->value);
+      else
+        fprintf(out, "  controller: evaluating, %d events pending\n", rec->value);
+      break;
+    case LOG_WATCH_DECISION:
+      if (rec->extra < 0)
+        fprintf(out, "  last decision: none\n");
+      else if (rec->aircraft_id < 0)
+        fprintf(out, "  last decision: %s at %s s\n", decision_names[rec->extra],
+                log_seconds(seconds, sizeof(seconds), rec->value));
+      else
+        fprintf(out, "  last decision: %s aircraft %d at %s s\n", decision_names[rec->extra],
+                rec->aircraft_id, log_seconds(seconds, sizeof(seconds), rec->value));
+      break;
+    case LOG_WATCH_QUEUE:
+      fprintf(out, "  %d waiting%s\n", rec->value, rec->value > 0 ? ", oldest first:" : "");
+      break;
+    case LOG_WATCH_WAITING:
+      fprintf(out, "    aircraft %d (%s) waits on its grant for %s s", rec->aircraft_id,
+              type_names[rec->aircraft_type], log_seconds(seconds, sizeof(seconds), rec->value));
+      if (rec->extra >= 0)
+        fprintf(out, ", %s %s s", rec->extra <= log_ms(rec->time) ? "out of fuel since" : "fuel runs out at",
+                log_seconds(seconds, sizeof(seconds), rec->extra));
+      fprintf(out, "\n");
+      break;
+    case LOG_WATCH_END:
+      fprintf(out, "=== End of watchdog snapshot ===\n\n");
+      break;
+    case LOG_WATCH_STARVING:
+      if (rec->aircraft_type == EMERGENCY)
+        fprintf(out, "Watchdog: emergency aircraft %d has waited at runway %d for more than "
+                "the emergency timeout of %d s\n", rec->aircraft_id, rec->runway,
+                config.emergency_timeout);
+      else
+        fprintf(out, "Watchdog: %s aircraft %d still waits at runway %d more than %d s "
+                "(the emergency timeout) after its fuel ran out\n", type_names[rec->aircraft_type],
+                rec->aircraft_id, rec->runway, config.emergency_timeout);
+      break;
+  }
+}
+
+/* Log a watchdog report, see runway_log.h for what the fields hold. */
+static void log_watch(int event, int runway, int aircraft_id, int aircraft_type, int value, int extra)
+{
+  log_record rec;
+
+  if (log_mode == LOG_OFF)
+    return;
+  memset(&rec, 0, sizeof(rec));
+  rec.event = (short)event;
+  rec.runway = (short)runway;
+  rec.aircraft_id = aircraft_id;
+  rec.aircraft_type = (short)aircraft_type;
+  rec.direction = -1;
+  rec.value = value;
+  rec.extra = extra;
+  log_push(&rec);
+}
+
+static void log_pending_push(const log_record *rec)
+{
+  int i;
+
+  if (log_pending_count == log_pending_capacity)
+  {
+    int capacity = log_pending_capacity ? 2 * log_pending_capacity : 1024;
+    log_record *items = realloc(log_pending, capacity * sizeof(*items));
+
+    if (items == NULL)
+    {
+      printf("runway: out of memory in the log writer\n");
+      exit(1);
+    }
+    log_pending = items;
+    log_pending_capacity = capacity;
+  }
+  for (i = log_pending_count++; i > 0 && log_pending[(i - 1) / 2].seq > rec->seq; i = (i - 1) / 2)
+    log_pending[i] = log_pending[(i - 1) / 2];
+  log_pending[i] = *rec;
+}
+
+static void log_pending_pop()
+{
+  log_record last = log_pending[--log_pending_count];
+  int i = 0, child;
+
+  while ((child = 2 * i + 1) < log_pending_count)
+  {
+    if (child + 1 < log_pending_count && log_pending[child + 1].seq < log_pending[child].seq)
+      child++;
+    if (log_pending[child].seq >= last.seq)
+      break;
+    log_pending[i] = log_pending[child];
+    i = child;
+  }
+  if (log_pending_count > 0)
+    log_pending[i] = last;
+}
+
+/* Write out the first pending record, whose turn it must be. */
+static void log_write_next()
+{
+  if (log_mode == LOG_BINARY)
+    fwrite(&log_pending[0], sizeof(log_record), 1, log_out);
+  else
+    log_format(log_out, &log_pending[0]);
+  log_pending_pop();
+  __atomic_store_n(&log_emitted, log_emitted + 1, __ATOMIC_SEQ_CST);
+}
+
+/* Move everything in the rings to log_pending and write out the records
+ * whose turn it is.  Returns the number of records drained.
+ */
+static long log_drain()
+{
+  log_ring *ring;
+  unsigned long head, tail;
+  long drained = 0;
+
+  for (ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+  {
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    for (tail = ring->tail; tail != head; tail++)
+      log_pending_push(&ring->records[tail % LOG_RING_RECORDS]);
+    drained += head - ring->tail;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  while (log_pending_count > 0 && log_pending[0].seq == log_emitted)
+  {
+    log_write_next();
+  }
+  return drained;
+}
+
+static int log_rings_empty()
+{
+  log_ring *ring;
+
+  for (ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+  {
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != ring->tail)
+      return 0;
+  }
+  return 1;
+}
+
+/* 1 if some ring is at least half full, so the writer should not wait. */
+static int log_rings_half_full()
+{
+  log_ring *ring;
+
+  for (ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+  {
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - ring->tail >= LOG_RING_RECORDS / 2)
+      return 1;
+  }
+  return 0;
+}
+
+static void *log_writer(void *arg)
+{
+  struct timespec deadline;
+
+  (void)arg;
+
+  while (1)
+  {
+    log_drain();
+    fflush(log_out);
+
+    pthread_mutex_lock(&Mutex_LOG);
+    if (log_flush_waiters > 0)
+      pthread_cond_broadcast(&Cond_LOG_FLUSHED);
+    if (log_space_waiters > 0)
+      pthread_cond_broadcast(&Cond_LOG_SPACE);
+    if (log_stopping && log_rings_empty())
+    {
+      pthread_mutex_unlock(&Mutex_LOG);
+      break;
+    }
+    if (!log_stopping)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_nsec += LOG_WRITER_PERIOD;
+      if (deadline.tv_nsec >= NSEC_PER_SEC)
+      {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NSEC_PER_SEC;
+      }
+      __atomic_store_n(&log_writer_idle, 1, __ATOMIC_SEQ_CST);
+      if (!log_rings_half_full())
+        pthread_cond_timedwait(&Cond_LOG, &Mutex_LOG, &deadline);
+      __atomic_store_n(&log_writer_idle, 0, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&Mutex_LOG);
+  }
+
+  /* every thread that logs has finished, so nothing can be missing */
+  while (log_pending_count > 0)
+  {
+    log_write_next();
+  }
+  fflush(log_out);
+  return NULL;
+}
+
+/* Start the writer.  Called before any simulation thread runs. */
+static void log_start()
+{
+  log_header header;
+  int result;
+
+  if (log_mode == LOG_OFF)
+    return;
+  log_out = stdout;
+  if (log_mode == LOG_BINARY)
+  {
+    if ((log_out = fopen(log_binary_path, "wb")) == NULL)
+    {
+      printf("Cannot open log file %s for writing.\n", log_binary_path);
+      exit(1);
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+    header.version = LOG_VERSION;
+    header.record_size = sizeof(log_record);
+    header.runway_count = runway_count;
+    header.max_runway_capacity = config.max_runway_capacity;
+    header.controller_limit = config.controller_limit;
+    header.emergency_timeout = config.emergency_timeout;
+    fwrite(&header, sizeof(header), 1, log_out);
+  }
+
+  log_stopping = 0;
+  log_full_waits = 0;
+  pthread_cond_init(&Cond_LOG, &clock_condattr);
+  result = pthread_create(&log_writer_tid, NULL, log_writer, NULL);
+  if (result)
+  {
+    printf("runway:  pthread_create failed for the log writer: %s\n", strerror(result));
+    exit(1);
+  }
+}
+
+/* Write out everything logged so far, e.g. before an assertion fails. */
+static void log_flush()
+{
+  unsigned long long target = __atomic_load_n(&log_next_seq, __ATOMIC_SEQ_CST);
+
+  if (log_mode == LOG_OFF)
+    return;
+  pthread_mutex_lock(&Mutex_LOG);
+  log_flush_waiters++;
+  pthread_cond_signal(&Cond_LOG);
+  while (__atomic_load_n(&log_emitted, __ATOMIC_SEQ_CST) < target)
+  {
+    pthread_cond_wait(&Cond_LOG_FLUSHED, &Mutex_LOG);
+  }
+  log_flush_waiters--;
+  pthread_mutex_unlock(&Mutex_LOG);
+}
+
+/* Drain the rings and stop the writer once every logging thread is done. */
+static void log_stop()
+{
+  log_ring *ring;
+
+  if (log_mode == LOG_OFF)
+    return;
+  pthread_mutex_lock(&Mutex_LOG);
+  log_stopping = 1;
+  pthread_cond_signal(&Cond_LOG);
+  pthread_mutex_unlock(&Mutex_LOG);
+  pthread_join(log_writer_tid, NULL);
+  pthread_cond_destroy(&Cond_LOG);
+
+  if (log_out != stdout)
+    fclose(log_out);
+  while ((ring = log_rings) != NULL)
+  {
+    log_rings = ring->next;
+    free(ring);
+  }
+  free(log_pending);
+  log_pending = NULL;
+  log_pending_count = log_pending_capacity = 0;
+  log_free = NULL;
+  log_local = NULL;
+}
+
+/*** Watchdog reports ***/
+
+/* Aircraft on or queued for a runway, or released and not yet queued. */
+static int watchdog_in_flight()
+{
+  int n = __atomic_load_n(&arrivals_pending, __ATOMIC_RELAXED);
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+    n += __atomic_load_n(&runways[i].queued, __ATOMIC_RELAXED)
+         + runway_snapshot(&runways[i].state).total;
+  return n;
+}
+
+/* Log r's part of the snapshot.  What is needed is copied under r->mutex
+ * and logged after it is dropped.
+ */
+static void watchdog_dump_runway(runway_info *r, sim_time_t now)
+{
+  aircraft_info oldest[WATCHDOG_OLDEST];
+  int count = 0;
+  runway_view rv;
+  log_record rec;
+  int waiting, blocked, since_break;
+  int decision, decision_aircraft;
+  sim_time_t decision_time;
+  int idle = __atomic_load_n(&r->controller_idle, __ATOMIC_RELAXED);
+  int events = __atomic_load_n(&r->controller_events, __ATOMIC_RELAXED);
+  int i, k;
+
+  pthread_mutex_lock(&r->mutex);
+  rv = runway_snapshot(&r->state);
+  waiting = r->wait_queue.count;
+  blocked = r->blocked;
+  since_break = r->aircraft_since_break;
+  decision = r->last_decision;
+  decision_aircraft = r->last_decision_aircraft;
+  decision_time = r->last_decision_time;
+  /* the queue is ordered by policy, not by age; keep the oldest few */
+  for (i = 0; i < r->wait_queue.count; i++)
+  {
+    aircraft_info *ai = r->wait_queue.items[i];
+
+    for (k = count; k > 0 && oldest[k - 1].times[LIFE_ENQUEUE] > ai->times[LIFE_ENQUEUE]; k--)
+      if (k < WATCHDOG_OLDEST)
+        oldest[k] = oldest[k - 1];
+    if (k < WATCHDOG_OLDEST)
+    {
+      oldest[k] = *ai;
+      if (count < WATCHDOG_OLDEST)
+        count++;
+    }
+  }
+  pthread_mutex_unlock(&r->mutex);
+
+  memset(&rec, 0, sizeof(rec));
+  rec.event = LOG_WATCH_RUNWAY;
+  rec.runway = (short)r->id;
+  rec.aircraft_id = -1;
+  rec.aircraft_type = -1;
+  rec.direction = (short)rv.direction;
+  rec.value = rv.consecutive;
+  rec.total = (unsigned char)rv.total;
+  rec.commercial = (unsigned char)rv.commercial;
+  rec.cargo = (unsigned char)rv.cargo;
+  rec.emergency = (unsigned char)rv.emergency;
+  rec.extra = since_break;
+  log_push(&rec);
+  log_watch(LOG_WATCH_CONTROLLER, r->id, -1, -1, events,
+            blocked ? WATCH_PAUSED : idle ? WATCH_IDLE : WATCH_EVALUATING);
+  log_watch(LOG_WATCH_DECISION, r->id, decision < 0 ? -1 : decision_aircraft, -1,
+            decision < 0 ? 0 : log_ms(decision_time), decision);
+  log_watch(LOG_WATCH_QUEUE, r->id, -1, -1, waiting, count);
+  for (i = 0; i < count; i++)
+  {
+    aircraft_info *ai = &oldest[i];
+
+    log_watch(LOG_WATCH_WAITING, r->id, ai->aircraft_id, ai->aircraft_type,
+              log_ms(now - ai->times[LIFE_ENQUEUE]),
+              ai->aircraft_type == EMERGENCY ? -1 : log_ms(ai->fuel_deadline));
+  }
+}
+
+/* Log the snapshot, headed by why it was taken: the stall threshold, or 0
+ * for a SIGUSR1.
+ */
+static void watchdog_dump(int stall_seconds)
+{
+  sim_time_t now = sim_now();
+  int waiting_for;
+  int i;
+
+  if (__atomic_load_n(&backlog_waiting, __ATOMIC_RELAXED))
+    waiting_for = WATCH_BACKLOG;
+  else if (streaming && __atomic_load_n(&forecast_next, __ATOMIC_RELAXED) == 0)
+    waiting_for = WATCH_STREAM;
+  else
+    waiting_for = WATCH_ARRIVING;
+  log_watch(LOG_WATCHDOG, -1, __atomic_load_n(&aircraft_done, __ATOMIC_RELAXED), -1,
+            stall_seconds, 0);
+  log_watch(LOG_WATCH_ARRIVALS, -1, __atomic_load_n(&arrivals_pending, __ATOMIC_RELAXED), -1,
+            watchdog_in_flight(), waiting_for);
+  for (i = 0; i < runway_count; i++)
+    watchdog_dump_runway(&runways[i], now);
+  log_watch(LOG_WATCH_END, -1, -1, -1, 0, 0);
+}
+
+/* Report the aircraft at r that are starving and have not been reported
+ * yet.  Returns when the next of the others starves, SIM_FOREVER if none
+ * waits.  Like promote_fuel_critical(), only the due ones are looked at.
+ */
+static sim_time_t watchdog_check_runway(runway_info *r, sim_time_t now)
+{
+  sim_time_t timeout = (sim_time_t)config.emergency_timeout * NSEC_PER_SEC;
+  sim_time_t next;
+  aircraft_info *ai;
+
+  pthread_mutex_lock(&r->mutex);
+  while ((ai = aircraft_heap_top(&r->watchdog_heap)) != NULL && ai->watchdog_due <= now)
+  {
+    aircraft_heap_remove(&r->watchdog_heap, ai);
+    ai->watchdog_flagged = 1;
+    watchdog_starving++;
+    /* watchdog_due is one ns past the timeout */
+    log_watch(LOG_WATCH_STARVING, r->id, ai->aircraft_id, ai->aircraft_type,
+              log_ms(now - (ai->watchdog_due - 1 - timeout)), 0);
+  }
+  next = ai ? ai->watchdog_due : SIM_FOREVER;
+  pthread_mutex_unlock(&r->mutex);
+  return next;
+}
+
+/*
+ * Function: watchdog_timer
+ * Parameters: arg - unused
+ * Returns: NULL
+ * Description: Simulation thread that reports starving aircraft until
+ *              watchdog_stop().  It sleeps on the simulation clock until
+ *              the next waiting aircraft starves, but for no longer than
+ *              the emergency timeout, which is the soonest an aircraft
+ *              that queues meanwhile can starve.  With nobody waiting it
+ *              sleeps until watchdog_note() sees an aircraft queue.
+ */
+static void *watchdog_timer(void *arg)
+{
+  sim_time_t timeout = (sim_time_t)config.emergency_timeout * NSEC_PER_SEC;
+  sim_time_t now, next, deadline;
+  long queued;
+  int i;
+
+  (void)arg;
+
+  if (timeout < NSEC_PER_SEC / 1000)
+    timeout = NSEC_PER_SEC / 1000;
+  pthread_mutex_lock(&Mutex_WATCHDOG);
+  while (!watchdog_stopping)
+  {
+    pthread_mutex_unlock(&Mutex_WATCHDOG);
+    queued = __atomic_load_n(&watchdog_queued, __ATOMIC_SEQ_CST);
+    now = sim_now();
+    next = SIM_FOREVER;
+    for (i = 0; i < runway_count; i++)
+    {
+      deadline = watchdog_check_runway(&runways[i], now);
+      if (deadline < next)
+        next = deadline;
+    }
+
+    pthread_mutex_lock(&Mutex_WATCHDOG);
+    if (watchdog_stopping)
+      break;
+    if (next == SIM_FOREVER)
+    {
+      /* like notify_controller(), announce the wait before the last look */
+      __atomic_store_n(&watchdog_timer_idle, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&watchdog_queued, __ATOMIC_SEQ_CST) == queued)
+        sim_cond_wait(&Cond_WATCHDOG_TIMER, &Mutex_WATCHDOG);
+      __atomic_store_n(&watchdog_timer_idle, 0, __ATOMIC_RELAXED);
+    }
+    else
+    {
+      deadline = now + timeout;
+      sim_cond_timedwait(&Cond_WATCHDOG_TIMER, &Mutex_WATCHDOG, next < deadline ? next : deadline);
+    }
+  }
+  pthread_mutex_unlock(&Mutex_WATCHDOG);
+  log_detach();
+  sim_thread_end();
+  return NULL;
+}
+
+/*
+ * Function: watchdog_thread
+ * Parameters: arg - unused
+ * Returns: NULL
+ * Description: Looks at the simulation once a second of wall-clock time
+ *              until watchdog_stop().  Reports a stall once
+ *              watchdog_progress has not moved for watchdog_seconds while
+ *              aircraft are in flight, and logs the snapshot for a stall
+ *              or a SIGUSR1.  It is not a simulation thread, so it never
+ *              holds up the virtual clock.
+ */
+static void *watchdog_thread(void *arg)
+{
+  struct timespec deadline, wall;
+  long progress, seen = -1;
+  long long since = 0, now_wall;
+  int stalled = 0;
+
+  (void)arg;
+
+  pthread_mutex_lock(&Mutex_WATCHDOG);
+  while (!watchdog_stopping)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec++;
+    pthread_cond_timedwait(&Cond_WATCHDOG, &Mutex_WATCHDOG, &deadline);
+    if (watchdog_stopping)
+      break;
+    pthread_mutex_unlock(&Mutex_WATCHDOG);
+
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    now_wall = (long long)wall.tv_sec * NSEC_PER_SEC + wall.tv_nsec;
+    progress = __atomic_load_n(&watchdog_progress, __ATOMIC_RELAXED);
+    if (progress != seen || watchdog_in_flight() == 0)
+    {
+      seen = progress;
+      since = now_wall;
+      stalled = 0;
+    }
+    else if (!stalled && now_wall - since >= (long long)watchdog_seconds * NSEC_PER_SEC)
+    {
+      stalled = 1;
+      watchdog_stalls++;
+      watchdog_dump(watchdog_seconds);
+    }
+    if (watchdog_dump_requested)
+    {
+      watchdog_dump_requested = 0;
+      watchdog_dump(0);
+    }
+    pthread_mutex_lock(&Mutex_WATCHDOG);
+  }
+  pthread_mutex_unlock(&Mutex_WATCHDOG);
+  log_detach();
+  return NULL;
+}
+
+/* Start the watchdog if --watchdog is on.  Called once the runways are
+ * set up.
+ */
+static void watchdog_start()
+{
+  struct sigaction sa;
+  int result;
+
+  if (watchdog_seconds == 0)
+    return;
+  watchdog_progress = 0;
+  watchdog_queued = 0;
+  watchdog_stalls = 0;
+  watchdog_starving = 0;
+  watchdog_stopping = 0;
+  watchdog_timer_idle = 0;
+  pthread_cond_init(&Cond_WATCHDOG, &clock_condattr);
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = watchdog_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, NULL);
+  sim_thread_begin();
+  result = pthread_create(&watchdog_timer_tid, NULL, watchdog_timer, NULL);
+  if (result == 0)
+    result = pthread_create(&watchdog_tid, NULL, watchdog_thread, NULL);
+  if (result)
+  {
+    printf("runway:  pthread_create failed for the watchdog: %s\n", strerror(result));
+    exit(1);
+  }
+}
+
+static void watchdog_stop()
+{
+  if (watchdog_seconds == 0)
+    return;
+  pthread_mutex_lock(&Mutex_WATCHDOG);
+  watchdog_stopping = 1;
+  pthread_cond_signal(&Cond_WATCHDOG);
+  sim_cond_signal(&Cond_WATCHDOG_TIMER);
+  pthread_mutex_unlock(&Mutex_WATCHDOG);
+  pthread_join(watchdog_timer_tid, NULL);
+  pthread_join(watchdog_tid, NULL);
+  pthread_cond_destroy(&Cond_WATCHDOG);
+}
+
+/* Code executed by controller to simulate taking a break 
+ * You do not need to add anything here.  
+ */
+static void take_break(runway_info *r)
+{
+  log_runway(LOG_BREAK, r, NULL, __atomic_load_n(&r->state, __ATOMIC_ACQUIRE));
+  sim_sleep(config.break_time * NSEC_PER_SEC);
+  assert( runway_snapshot(&r->state).total == 0 );
+  r->aircraft_since_break = 0;
+  r->breaks++;
+  log_runway(LOG_BREAK_END, r, NULL, __atomic_load_n(&r->state, __ATOMIC_ACQUIRE));
+}
+
+/* Code executed to switch runway direction
+ * You do not need to add anything here.
+ */
+static void switch_direction(runway_info *r)
+{
+  runway_word w = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+  int current_direction = runway_get(w, RUNWAY_DIRECTION);
+
+  log_runway(LOG_SWITCHING, r, NULL, w);
+  
+  assert( runway_snapshot(&r->state).total == 0 );  // Runway must be empty to switch
+  
+  sim_sleep(config.direction_switch_time * NSEC_PER_SEC);
+  
+  current_direction = (current_direction == NORTH) ? SOUTH : NORTH;
+  w = runway_set_direction(&r->state, current_direction);
+  r->switches++;
+
+  log_runway(LOG_SWITCHED, r, NULL, w);
+}
+
+/* Take the controller's break while the runway turns around.  The two
+ * overlap, so the runway is out of use for the longer of them instead of
+ * for both one after the other.
+ */
+static void switch_direction_on_break(runway_info *r)
+{
+  sim_time_t rest = (sim_time_t)(config.break_time - config.direction_switch_time) * NSEC_PER_SEC;
+
+  log_runway(LOG_BREAK, r, NULL, __atomic_load_n(&r->state, __ATOMIC_ACQUIRE));
+  switch_direction(r);
+  if (rest > 0)
+    sim_sleep(rest);
+  r->aircraft_since_break = 0;
+  r->breaks++;
+  log_runway(LOG_BREAK_END, r, NULL, __atomic_load_n(&r->state, __ATOMIC_ACQUIRE));
+}
+
+/* Wake the controller of r so it re-evaluates admissions right away.  A
+ * busy controller looks at controller_events again before it goes to
+ * sleep, so the mutex is only needed when it is already idle.
+ */
+static void notify_controller(runway_info *r)
+{
+  int before = __atomic_fetch_add(&r->controller_events, 1, __ATOMIC_SEQ_CST);
+
+  __atomic_fetch_add(&r->controller_notifies, 1, __ATOMIC_RELAXED);
+  if (!__atomic_load_n(&r->controller_idle, __ATOMIC_SEQ_CST))
+    return;
+
+  pthread_mutex_lock(&r->controller_mutex);
+  r->controller_notify_locks++;
+  if (r->controller_idle && before == 0)
+  {
+    r->controller_event_time = sim_now();
+  }
+  sim_cond_signal(&r->controller_cond);
+  pthread_mutex_unlock(&r->controller_mutex);
+}
+
+/* Queue bookkeeping shared by arrivals and stealing.  Caller holds
+ * r->mutex and ai->runway is r.
+ */
+static void runway_enqueue(runway_info *r, aircraft_info *ai)
+{
+  int dir = required_direction(ai);
+
+  aircraft_heap_push(&r->wait_queue, ai);
+  if (dir >= 0)
+  {
+    r->waiting_for[dir]++;
+    if (!ai->fuel_critical)
+      aircraft_heap_push(&r->fuel_heap, ai);
+  }
+  else if (!ai->emergency_urgent)
+    aircraft_heap_push(&r->urgent_heap, ai);
+  if (watchdog_seconds > 0 && !ai->watchdog_flagged)
+    aircraft_heap_push(&r->watchdog_heap, ai);
+  __atomic_store_n(&r->queued, r->wait_queue.count, __ATOMIC_RELAXED);
+  if (r->wait_queue.count > r->queue_peak)
+    r->queue_peak = r->wait_queue.count;
+  if (r->blocked && r->blocked_waiting == SIM_FOREVER)
+    r->blocked_waiting = sim_now();
+}
+
+static void runway_dequeue(runway_info *r, aircraft_info *ai)
+{
+  int dir = required_direction(ai);
+
+  aircraft_heap_remove(&r->wait_queue, ai);
+  aircraft_heap_remove(&r->fuel_heap, ai);
+  aircraft_heap_remove(&r->urgent_heap, ai);
+  aircraft_heap_remove(&r->watchdog_heap, ai);
+  if (dir >= 0)
+    r->waiting_for[dir]--;
+  __atomic_store_n(&r->queued, r->wait_queue.count, __ATOMIC_RELAXED);
+  /* the last one waiting for a blocked runway was stolen */
+  if (r->blocked && r->wait_queue.count == 0 && r->blocked_waiting != SIM_FOREVER)
+  {
+    r->dead_time += sim_now() - r->blocked_waiting;
+    r->blocked_waiting = SIM_FOREVER;
+  }
+}
+
+/* Pick the runway an arriving aircraft queues at: the least loaded one,
+ * counting a runway that points the wrong way as full.  The choice only
+ * needs to be good, not exact, so it reads the other runways unlocked.
+ */
+static runway_info *choose_runway_for(int dir)
+{
+  runway_info *best = &runways[0];
+  int best_load = INT_MAX;
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+  {
+    runway_view v = runway_snapshot(&runways[i].state);
+    int load = __atomic_load_n(&runways[i].queued, __ATOMIC_RELAXED) + v.total;
+
+    if (dir >= 0 && v.direction != dir)
+      load += config.max_runway_capacity;
+    if (load < best_load)
+    {
+      best = &runways[i];
+      best_load = load;
+    }
+  }
+  return best;
+}
+
+static runway_info *choose_runway(aircraft_info *ai)
+{
+  if (schedule_mode == SCHEDULE_REPLAY && replay_route[ai->aircraft_id] >= 0)
+    return &runways[replay_route[ai->aircraft_id]];
+  return choose_runway_for(required_direction(ai));
+}
+
+/* Lock the runway ai is queued at.  ai->runway only changes while both
+ * the old and the new runway are locked, so check it again once locked.
+ */
+static runway_info *lock_aircraft_runway(aircraft_info *ai)
+{
+  while (1)
+  {
+    runway_info *r = __atomic_load_n(&ai->runway, __ATOMIC_ACQUIRE);
+
+    pthread_mutex_lock(&r->mutex);
+    if (__atomic_load_n(&ai->runway, __ATOMIC_ACQUIRE) == r)
+      return r;
+    pthread_mutex_unlock(&r->mutex);
+  }
+}
+
+/* Put an arriving aircraft on the wait queue of r.  Commercial and cargo
+ * aircraft also register their fuel deadline, emergencies the point half
+ * way through their timeout.  Caller holds r->mutex.
+ */
+static void queue_aircraft(runway_info *r, aircraft_info *ai)
+{
+  if (required_direction(ai) >= 0)
+    ai->fuel_deadline = ai->times[LIFE_ARRIVAL] + ai->fuel_reserve;
+  ai->times[LIFE_ENQUEUE] = sim_now();
+  if (ai->aircraft_type == EMERGENCY)
+    ai->urgent_deadline = ai->times[LIFE_ENQUEUE]
+                          + (sim_time_t)config.emergency_timeout * NSEC_PER_SEC / 2;
+  if (policy->on_arrival)
+    policy->on_arrival(ai);
+  __atomic_store_n(&ai->runway, r, __ATOMIC_RELEASE);
+  ai->watchdog_flagged = 0;
+  ai->watchdog_due = (ai->aircraft_type == EMERGENCY ? ai->times[LIFE_ENQUEUE] : ai->fuel_deadline)
+                     + (sim_time_t)config.emergency_timeout * NSEC_PER_SEC + 1;
+  runway_enqueue(r, ai);
+  ai->schedule_step = 0;
+  schedule_note(r, SCHED_QUEUE, ai);
+  log_runway(LOG_ENQUEUE, r, ai, __atomic_load_n(&r->state, __ATOMIC_ACQUIRE));
+  ai->state = AIRCRAFT_WAITING;
+  __atomic_fetch_sub(&arrivals_pending, 1, __ATOMIC_RELAXED);
+}
+
+/* Admit ai: put it on the runway, take it off the queues and wake it.
+ * Returns 0 if the runway cannot take it right now.  Caller holds
+ * r->mutex.
+ */
+static int grant_runway(runway_info *r, aircraft_info *ai)
+{
+  runway_word w;
+  sim_time_t now;
+
+  if ((w = runway_try_admit(&r->state, ai->aircraft_type)) == 0)
+    return 0;
+  now = sim_now();
+  if (!r->busy)
+  {
+    r->busy = 1;
+    r->busy_since = now;
+  }
+  if (record_waits)
+    sample_push(&r->waits[ai->aircraft_type], (double)(now - ai->times[LIFE_ENQUEUE]) / NSEC_PER_SEC);
+  if (live != NULL)
+    r->live_waits[r->live_wait_count++ % LIVE_WAITS] = (int)((now - ai->times[LIFE_ENQUEUE]) / 1000000);
+  ai->times[LIFE_GRANT] = now;
+  ai->landing_direction = runway_get(w, RUNWAY_DIRECTION);
+  runway_dequeue(r, ai);
+  if (streaming)
+    backlog_notify();
+  r->aircraft_since_break = r->aircraft_since_break + 1;
+  r->landings++;
+  schedule_note(r, SCHED_GRANT, ai);
+  log_runway(LOG_GRANT, r, ai, w);
+
+  ai->state = AIRCRAFT_ON_RUNWAY;
+  sim_cond_signal(&ai->grant);
+  return 1;
+}
+
+/* Take a waiting aircraft from another runway's queue that r could put on
+ * its runway now, or, if r is empty, one that needs the direction neither
+ * runway is pointing in.  The victim's top aircraft is left alone if the victim can admit
+ * it itself.  Called with r->mutex held and r's queue empty; the other
+ * runways are only try-locked, so two controllers stealing from each
+ * other cannot deadlock.  Returns 1 if an aircraft was moved to r.
+ */
+static int steal_aircraft(runway_info *r)
+{
+  runway_word own = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+  aircraft_info *best = NULL;
+  int k;
+
+  if (runway_count == 1 || runway_get(own, RUNWAY_TOTAL) >= config.max_runway_capacity
+      || r->aircraft_since_break >= config.controller_limit)
+    return 0;
+
+  for (k = 1; k < runway_count && best == NULL; k++)
+  {
+    runway_info *victim = &runways[(r->id + k) % runway_count];
+    runway_word theirs;
+    aircraft_info *top;
+    int i;
+
+    if (__atomic_load_n(&victim->queued, __ATOMIC_RELAXED) == 0
+        || pthread_mutex_trylock(&victim->mutex) != 0)
+      continue;
+
+    theirs = __atomic_load_n(&victim->state, __ATOMIC_ACQUIRE);
+    top = aircraft_heap_top(&victim->wait_queue);
+    for (i = 0; i < victim->wait_queue.count; i++)
+    {
+      aircraft_info *ai = victim->wait_queue.items[i];
+
+      if (ai == top && runway_admissible(theirs, ai->aircraft_type))
+        continue;
+      if (!runway_admissible(own, ai->aircraft_type))
+      {
+        /* Turning r around for it only pays off if the victim would
+         * have to turn around as well.
+         */
+        if (runway_get(own, RUNWAY_TOTAL) > 0
+            || runway_get(theirs, RUNWAY_DIRECTION) == required_direction(ai))
+          continue;
+      }
+      if (best == NULL || policy->before(ai, best))
+        best = ai;
+    }
+    if (best)
+    {
+      runway_dequeue(victim, best);
+      __atomic_store_n(&best->runway, r, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&victim->mutex);
+  }
+
+  if (best == NULL)
+    return 0;
+  runway_enqueue(r, best);
+  r->stolen++;
+  schedule_note(r, SCHED_STEAL, best);
+  return 1;
+}
+
+/* Promote every aircraft whose fuel deadline has passed to fuel-critical,
+ * and every emergency whose urgent deadline has passed to urgent, which
+ * moves them to the front of the wait queue.  Caller holds r->mutex.
+ */
+static void promote_fuel_critical(runway_info *r)
+{
+  sim_time_t now = sim_now();
+  aircraft_info *ai;
+
+  while((ai = aircraft_heap_top(&r->fuel_heap)) != NULL && ai->fuel_deadline <= now)
+  {
+    aircraft_heap_remove(&r->fuel_heap, ai);
+    ai->fuel_critical = 1;
+    ai->times[LIFE_FUEL] = now;
+    r->fuel_emergencies++;
+    log_event(LOG_FUEL_OUT, r->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+    aircraft_heap_update(&r->wait_queue, ai);
+  }
+  while((ai = aircraft_heap_top(&r->urgent_heap)) != NULL && ai->urgent_deadline <= now)
+  {
+    aircraft_heap_remove(&r->urgent_heap, ai);
+    ai->emergency_urgent = 1;
+    aircraft_heap_update(&r->wait_queue, ai);
+  }
+}
+
+/* Earliest fuel deadline of any aircraft waiting at r, or the end of a
+ * planner hold if that comes first; SIM_FOREVER if there is neither.
+ */
+static sim_time_t next_fuel_deadline(runway_info *r)
+{
+  sim_time_t deadline = SIM_FOREVER;
+  aircraft_info *ai;
+
+  pthread_mutex_lock(&r->mutex);
+  if((ai = aircraft_heap_top(&r->fuel_heap)) != NULL)
+    deadline = ai->fuel_deadline;
+  if((ai = aircraft_heap_top(&r->urgent_heap)) != NULL && ai->urgent_deadline < deadline)
+    deadline = ai->urgent_deadline;
+  if(r->plan_until < deadline)
+    deadline = r->plan_until;
+  pthread_mutex_unlock(&r->mutex);
+  return deadline;
+}
+
+/* Direction planner.  The reactive rule turns the runway around as soon
+ * as the best waiting aircraft needs the other direction.  When an
+ * aircraft for the current direction is due within config.lookahead
+ * seconds, that costs a switch now and another one to come back for it.
+ * Holding the direction until it arrives batches it with the traffic
+ * already served and saves the round trip, as long as
+ *  - the direction still has part of its config.direction_limit turn left,
+ *  - nobody waiting is fuel-critical, and nobody's fuel runs out before
+ *    the held-for aircraft has landed and the runway has been switched,
+ *  - the held-for aircraft would queue at this runway, and
+ *  - idling until it arrives costs less than the switch it saves.
+ * Returns 1 if r should hold; the controller re-plans when an event comes
+ * or at r->plan_until at the latest.  Caller holds r->mutex.
+ */
+static int plan_hold(runway_info *r, aircraft_info *top, runway_view rv)
+{
+  sim_time_t now = sim_now();
+  sim_time_t due, landed, switch_time = config.direction_switch_time * NSEC_PER_SEC;
+  aircraft_info *first;
+
+  if (config.lookahead == 0 || top->fuel_critical || rv.consecutive >= config.direction_limit)
+    return 0;
+
+  pthread_mutex_lock(&Mutex_FORECAST);
+  due = forecast_due[rv.direction];
+  landed = due + forecast_runway_time[rv.direction];
+  pthread_mutex_unlock(&Mutex_FORECAST);
+
+  if (due == SIM_FOREVER || due - now > (sim_time_t)config.lookahead * NSEC_PER_SEC
+      || due - now > switch_time)
+    return 0;
+  if ((first = aircraft_heap_top(&r->fuel_heap)) != NULL
+      && first->fuel_deadline <= landed + 2 * switch_time)
+    return 0;
+  if (choose_runway_for(rv.direction) != r)
+    return 0;
+
+  if (r->plan_due != due)
+    r->holds++;
+  r->plan_due = due;
+  r->plan_until = due + 1;
+  return 1;
+}
+
+/* Take the runway out of use for a break or a switch, decision being one
+ * of the SCHED_* breaks and switches.  The controller drops r->mutex
+ * meanwhile; the time aircraft spend waiting for the runway to come back
+ * is added to r->dead_time.  Caller holds r->mutex and r is empty.
+ */
+static void controller_pause(runway_info *r, int decision)
+{
+  int other = runway_snapshot(&r->state).direction == NORTH ? SOUTH : NORTH;
+
+  schedule_note(r, decision, NULL);
+  r->blocked = 1;
+  r->blocked_waiting = r->wait_queue.count > 0 ? sim_now() : SIM_FOREVER;
+  live_publish(r);
+  pthread_mutex_unlock(&r->mutex);
+  if (decision == SCHED_SWITCH)
+    switch_direction(r);
+  else if (decision == SCHED_SWITCH_BREAK)
+    switch_direction_on_break(r);
+  else
+    take_break(r);
+  pthread_mutex_lock(&r->mutex);
+  if (r->blocked_waiting != SIM_FOREVER)
+    r->dead_time += sim_now() - r->blocked_waiting;
+  r->blocked = 0;
+  watchdog_tick();
+
+  if (decision == SCHED_IDLE_BREAK)
+    r->breaks_idle++;
+  if (decision == SCHED_SWITCH_BREAK)
+    r->breaks_overlapped++;
+  if (decision == SCHED_SWITCH || decision == SCHED_SWITCH_BREAK)
+  {
+    r->queue_direction = other;
+    aircraft_heap_rebuild(&r->wait_queue);
+  }
+  promote_fuel_critical(r);
+}
+
+/* Whether the controller should take its break before it is due, given
+ * that the runway is of no use to anybody for the next covered ns anyway
+ * (a switch, or the gap until the next arrival).  A break that fits in
+ * the gap is free.  One that does not costs the part that sticks out, and
+ * is worth it once at least half of the aircraft before the break is due
+ * have been handled, since it saves a whole break later.
+ */
+static int early_break_pays(runway_info *r, sim_time_t covered)
+{
+  int left = config.controller_limit - r->aircraft_since_break;
+
+  if (!config.early_breaks || r->aircraft_since_break == 0)
+    return 0;
+  return (sim_time_t)config.break_time * NSEC_PER_SEC <= covered
+         || r->aircraft_since_break >= left;
+}
+
+/* How long r will stay idle with nobody waiting, going by the forecast:
+ * 0 if an aircraft has been released and has not queued yet, SIM_FOREVER
+ * once no more are coming.
+ */
+static sim_time_t idle_gap()
+{
+  sim_time_t next;
+
+  if (__atomic_load_n(&arrivals_pending, __ATOMIC_RELAXED) > 0)
+    return 0;
+  pthread_mutex_lock(&Mutex_FORECAST);
+  next = forecast_next;
+  pthread_mutex_unlock(&Mutex_FORECAST);
+  return next == SIM_FOREVER ? SIM_FOREVER : next - sim_now();
+}
+
+/* Move ai from the queue it waits in to r's for the replayed SCHED_STEAL
+ * d.  Returns 0 if ai is not waiting at another runway yet, or has not
+ * got to the step d is about.  Caller holds r->mutex; it is dropped for
+ * a moment when the other runway has the lower id, so the two are always
+ * locked in the same order.
+ */
+static int replay_steal(runway_info *r, aircraft_info *ai, const schedule_record *d)
+{
+  runway_info *victim = __atomic_load_n(&ai->runway, __ATOMIC_ACQUIRE);
+  int moved;
+
+  if (victim == NULL || victim == r)
+    return 0;
+  if (victim->id < r->id)
+  {
+    pthread_mutex_unlock(&r->mutex);
+    pthread_mutex_lock(&victim->mutex);
+    pthread_mutex_lock(&r->mutex);
+  }
+  else
+  {
+    pthread_mutex_lock(&victim->mutex);
+  }
+  moved = ai->aircraft_id == d->aircraft_id && ai->runway == victim
+          && ai->state == AIRCRAFT_WAITING && ai->schedule_step == d->step;
+  if (moved)
+  {
+    runway_dequeue(victim, ai);
+    __atomic_store_n(&ai->runway, r, __ATOMIC_RELEASE);
+    runway_enqueue(r, ai);
+    r->stolen++;
+    schedule_note(r, SCHED_STEAL, ai);
+  }
+  pthread_mutex_unlock(&victim->mutex);
+  return moved;
+}
+
+/* Take r's next recorded decisions, each once its time has come and the
+ * aircraft it is about is there.  Returns 1 while r has decisions left,
+ * and 0 once its schedule is used up so the controller decides for
+ * itself again.  Caller holds r->mutex.
+ */
+static int replay_decisions(runway_info *r)
+{
+  int i;
+
+  while (r->replay_next < r->replay_end)
+  {
+    const schedule_record *d = &replay_records[r->replay_next];
+    sim_time_t now = sim_now();
+    aircraft_info *ai = NULL;
+
+    if (d->decision == SCHED_QUEUE)
+    {
+      r->replay_next++;
+      continue;
+    }
+    if (now < d->time)
+    {
+      r->plan_until = d->time;
+      return 1;
+    }
+    if (d->aircraft_id >= 0)
+      ai = __atomic_load_n(&replay_aircraft[d->aircraft_id], __ATOMIC_ACQUIRE);
+
+    if (d->decision == SCHED_STEAL)
+    {
+      if (ai == NULL || !replay_steal(r, ai, d))
+        return 1;
+      /* another runway's next decision may be to steal it from r */
+      for (i = 0; i < runway_count; i++)
+        if (&runways[i] != r)
+          notify_controller(&runways[i]);
+    }
+    else if (d->decision == SCHED_GRANT)
+    {
+      if (ai == NULL || ai->aircraft_id != d->aircraft_id || ai->runway != r
+          || ai->state != AIRCRAFT_WAITING || ai->schedule_step != d->step
+          || !grant_runway(r, ai))
+        return 1;
+    }
+    else
+    {
+      if (runway_snapshot(&r->state).total > 0)
+        return 1;
+      controller_pause(r, d->decision);
+    }
+    if (now > d->time)
+      r->replay_late++;
+    r->replay_next++;
+  }
+  return 0;
+}
+
+/* Grant runway r to as many aircraft from the top of its wait queue as
+ * the rules allow, stealing from other runways when the queue runs dry.
+ * The controller must take a break every config.controller_limit
+ * aircraft; with config.early_breaks it takes it sooner when the runway
+ * is out of use anyway, during a switch or an idle gap, so the break does
+ * not keep anybody waiting later.  Called with r->mutex held; the mutex
+ * is dropped while the controller takes a break or switches direction,
+ * and nobody is admitted to r in the meantime.
+ */
+static void admit_aircraft(runway_info *r)
+{
+  aircraft_info *ai;
+  runway_view rv;
+  sim_time_t gap;
+  int dir;
+  int other;
+
+  r->plan_until = SIM_FOREVER;
+  promote_fuel_critical(r);
+  if(schedule_mode == SCHEDULE_REPLAY && replay_decisions(r))
+    return;
+  while(1)
+  {
+    rv = runway_snapshot(&r->state);
+    if(r->aircraft_since_break >= config.controller_limit)
+    {
+      if(rv.total > 0)
+        return;
+      controller_pause(r, SCHED_BREAK);
+      continue;
+    }
+
+    if((ai = aircraft_heap_top(&r->wait_queue)) == NULL)
+    {
+      if(steal_aircraft(r))
+        continue;
+      /* Nothing to do: rest now if the gap until the next arrival hides
+       * the break.
+       */
+      if(rv.total == 0 && (gap = idle_gap()) != SIM_FOREVER && early_break_pays(r, gap))
+      {
+        controller_pause(r, SCHED_IDLE_BREAK);
+        continue;
+      }
+      return;
+    }
+
+    /* Turn the runway around when the best candidate needs the other
+     * direction, or when this direction has had its turn and somebody is
+     * waiting on the other side, unless the candidate cannot wait.
+     */
+    dir = required_direction(ai);
+    other = rv.direction == NORTH ? SOUTH : NORTH;
+    if((dir >= 0 && dir != rv.direction)
+       || (rv.consecutive >= config.direction_limit && r->waiting_for[other] > 0
+           && !ai->fuel_critical && ai->aircraft_type != EMERGENCY))
+    {
+      if(rv.total > 0)
+        return;
+      if(dir >= 0 && dir != rv.direction && plan_hold(r, ai, rv))
+        return;
+      if(early_break_pays(r, (sim_time_t)config.direction_switch_time * NSEC_PER_SEC))
+        controller_pause(r, SCHED_SWITCH_BREAK);
+      else
+        controller_pause(r, SCHED_SWITCH);
+      continue;
+    }
+
+    if(!grant_runway(r, ai))
+      return;
+  }
+}
+
+/* r has aircraft it cannot admit yet; let idle runways come and steal. */
+static void wake_idle_runways(runway_info *r)
+{
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+  {
+    runway_info *o = &runways[i];
+
+    if (o != r && __atomic_load_n(&o->queued, __ATOMIC_RELAXED) == 0
+        && runway_snapshot(&o->state).total < config.max_runway_capacity)
+      notify_controller(o);
+  }
+}
+
+/* Code for the air traffic controller thread. This is fully implemented except for
+ * synchronization with the aircraft. See the comments within the function for details.
+ *Function: controller_thread
+ *Parameters: arg - the runway_info this controller is in charge of
+ *Returns: void
+ *Description: This controls which aircrafts can go on to the runway.
+ *             Waiting aircraft sit in a priority queue and the controller
+ *             grants the runway to the one on top, taking breaks and
+ *             switching direction as needed (see admit_aircraft()).
+ *             Between passes it sleeps until notify_controller() reports a change.
+ */
+void *controller_thread(void *arg)
+{
+  runway_info *r = (runway_info *)arg;
+
+  log_event(LOG_CONTROLLER_ARRIVED, r->id, -1, -1, -1, 0);
+
+  /* Loop while waiting for aircraft to arrive. */
+  while (1)
+  {
+    sim_time_t fuel_deadline = next_fuel_deadline(r);
+    int queued;
+
+    pthread_mutex_lock(&r->controller_mutex);
+    if (__atomic_load_n(&r->controller_events, __ATOMIC_SEQ_CST) == 0
+        && !__atomic_load_n(&controller_shutdown, __ATOMIC_SEQ_CST))
+    {
+      int timed_out = 0;
+
+      /* Announce that we are idle before the last look at controller_events;
+       * see notify_controller().
+       */
+      __atomic_store_n(&r->controller_idle, 1, __ATOMIC_SEQ_CST);
+      while (__atomic_load_n(&r->controller_events, __ATOMIC_SEQ_CST) == 0
+             && !__atomic_load_n(&controller_shutdown, __ATOMIC_SEQ_CST) && !timed_out)
+      {
+        timed_out = sim_cond_timedwait(&r->controller_cond, &r->controller_mutex, fuel_deadline) == ETIMEDOUT;
+      }
+      __atomic_store_n(&r->controller_idle, 0, __ATOMIC_SEQ_CST);
+      r->controller_wakeups++;
+      if (!timed_out && __atomic_load_n(&r->controller_events, __ATOMIC_SEQ_CST) > 0)
+      {
+        sim_time_t latency = sim_now() - r->controller_event_time;
+
+        r->controller_latency_total += latency;
+        if (latency > r->controller_latency_max)
+          r->controller_latency_max = latency;
+      }
+    }
+    if (__atomic_load_n(&controller_shutdown, __ATOMIC_SEQ_CST))
+    {
+      pthread_mutex_unlock(&r->controller_mutex);
+      break;
+    }
+    __atomic_store_n(&r->controller_events, 0, __ATOMIC_SEQ_CST);
+    r->controller_passes++;
+    pthread_mutex_unlock(&r->controller_mutex);
+
+    pthread_mutex_lock(&r->mutex);
+    admit_aircraft(r);
+    live_publish(r);
+    queued = r->wait_queue.count;
+    pthread_mutex_unlock(&r->mutex);
+
+    if (runway_count > 1 && queued > 0)
+    {
+      wake_idle_runways(r);
+    }
+  }
+  log_detach();
+  sim_thread_end();
+  pthread_exit(NULL);
+}
+
+
+/* Block until c is signalled.  m is held on entry and released on return.
+ * The enter functions below are resumable: after a wait they return 0 and
+ * re-check their predicate the next time they are called.  A dedicated
+ * aircraft thread blocks here and calls again right away; on the worker
+ * pool the aircraft is parked and the worker moves on to other aircraft.
+ */
+static void aircraft_wait(aircraft_info *ai, sim_cond_t *c, pthread_mutex_t *m)
+{
+  if (pool_size > 0)
+  {
+    sim_cond_park(c, m, &ai->task);
+    return;
+  }
+  sim_cond_wait(c, m);
+  pthread_mutex_unlock(m);
+}
+
+/* Sleep for t ns of simulation time, parking the aircraft on the pool. */
+static void aircraft_sleep(aircraft_info *ai, sim_time_t t)
+{
+  if (pool_size > 0)
+  {
+    sim_sleep_park(&ai->task, t);
+    return;
+  }
+  sim_sleep(t);
+}
+
+/* Queue ai at a runway on its first call, then wait until a controller
+ * grants it a runway.  Shared by the three enter functions below.
+ * Returns 1 once the aircraft is on the runway, 0 if it has to wait first.
+ */
+static int request_runway(aircraft_info *ai)
+{
+  runway_info *r;
+  int i;
+
+  if(ai->state == AIRCRAFT_ARRIVING)
+  {
+    r = choose_runway(ai);
+    pthread_mutex_lock(&r->mutex);
+    queue_aircraft(r, ai);
+    notify_controller(r);
+    /* a replayed schedule may have another runway steal it */
+    for (i = 0; schedule_mode == SCHEDULE_REPLAY && i < runway_count; i++)
+      if (&runways[i] != r)
+        notify_controller(&runways[i]);
+  }
+  else
+  {
+    r = lock_aircraft_runway(ai);
+  }
+  if(ai->state == AIRCRAFT_WAITING)
+  {
+    aircraft_wait(ai, &ai->grant, &r->mutex);
+    return 0;
+  }
+  pthread_mutex_unlock(&r->mutex);
+  return 1;
+}
+
+/* Code executed by a commercial aircraft to enter the runway.
+ * You have to implement this.  Do not delete the assert() statements,
+ * but feel free to add your own.
+ * Function: commercial_enter
+ * Parameters: aircraft_info - pointer to aircraft information structure.
+ * Returns: 1 once the aircraft is on the runway, 0 if it has to wait first
+ * Description: Commercial aircraft join the wait queue with their fuel
+ *              deadline and sleep until the controller grants them the
+ *              runway. If the deadline passes first the controller marks
+ *              the aircraft fuel-critical, which moves it to the front.
+ */
+int commercial_enter(aircraft_info *arg) 
+{
+  /* TODO */
+  /* Request permission to use the runway. You might also want to add      */
+  /* synchronization for the simulation variables below.                   */
+  /* Consider: runway capacity, direction (commercial prefer NORTH),       */
+  /* controller breaks, fuel levels, emergency priorities, and fairness.   */
+  /*  YOUR CODE HERE.                                                      */
+  return request_runway(arg);
+}
+
+/* Code executed by a cargo aircraft to enter the runway.
+ * You have to implement this.  Do not delete the assert() statements,
+ * but feel free to add your own.
+ * Function: cargo_enter
+ * Parameters: aircraft_info _ pointer to aircraft information structure.
+ * Returns: 1 once the aircraft is on the runway, 0 if it has to wait first
+ * Description: This function handles the way cargo enters the runway. The
+ *              aircraft joins the wait queue with its fuel deadline; the
+ *              controller makes the emergency warning and gives it priority
+ *              when the deadline passes, and signals it once it may go on.
+ */
+int cargo_enter(aircraft_info *ai) 
+{
+  /* TODO */
+  /* Request permission to use the runway. You might also want to add      */
+  /* synchronization for the simulation variables below.                   */
+  /* Consider: runway capacity, direction (cargo prefer SOUTH),            */
+  /* controller breaks, fuel levels, emergency priorities, and fairness.   */
+  /*  YOUR CODE HERE.                                                      */ 
+  return request_runway(ai);
+}
+
+/* Code executed by an emergency aircraft to enter the runway.
+ * You have to implement this.  Do not delete the assert() statements,
+ * but feel free to add your own.
+ * Function: emergency_enter
+ * Parameters:aircraft_info - pointer to aircraft information structure
+ * Returns: 1 once the aircraft is on the runway, 0 if it has to wait first
+ * Description: This functions controls the entrance of the incoming emergency
+ *              aircraft. The aircraft is queued ahead of everything except
+ *              fuel-critical aircraft and waits until the controller
+ *              signals it to get on the runway.
+ */
+int emergency_enter(aircraft_info *ai) 
+{
+  /* TODO */
+  /* Request permission to use the runway. You might also want to add      */
+  /* synchronization for the simulation variables below.                   */
+  /* Emergency aircraft have priority and must be admitted within 30s,     */
+  /* but still respect runway capacity and controller breaks.              */
+  /* Emergency aircraft can use either direction.                          */
+  /*  YOUR CODE HERE.                                                      */ 
+  return request_runway(ai);
+}
+
+/* Code executed by an aircraft to simulate the time spent on the runway
+ * You do not need to add anything here.  
+ */
+static void use_runway(aircraft_info *ai, sim_time_t t) 
+{
+  aircraft_sleep(ai, t);
+}
+
+
+/* Give back ai's place on its runway.  The runway's busy time is closed
+ * under its mutex when the last aircraft leaves; if the controller has
+ * admitted another one in the meantime the busy period just continues.
+ */
+static void runway_depart(aircraft_info *ai)
+{
+  runway_info *r = ai->runway;
+  runway_word w = runway_release(&r->state, ai->aircraft_type);
+
+  log_runway(LOG_RELEASE, r, ai, w);
+  if (runway_get(w, RUNWAY_TOTAL) == 0)
+  {
+    pthread_mutex_lock(&r->mutex);
+    if (r->busy && runway_snapshot(&r->state).total == 0)
+    {
+      r->busy_total += sim_now() - r->busy_since;
+      r->busy = 0;
+    }
+    pthread_mutex_unlock(&r->mutex);
+  }
+  watchdog_tick();
+  notify_controller(r);
+}
+
+/* Code executed by a commercial aircraft when leaving the runway.
+ * You need to implement this.  Do not delete the assert() statements,
+ * but feel free to add as many of your own as you like.
+ * Function:commercial_leave
+ * Parameters: ai - the aircraft leaving
+ * Returns: void
+ * Description: Handles when a aircraft leaves. Just a simple
+ *              atomic decrement of the runway state to get
+ *              out of the runway.
+ */
+static void commercial_leave(aircraft_info *ai) 
+{
+  /* 
+   *  TODO
+   *  YOUR CODE HERE. 
+   */
+  runway_depart(ai);
+}
+
+/* Code executed by a cargo aircraft when leaving the runway.
+ * You need to implement this.  Do not delete the assert() statements,
+ * but feel free to add as many of your own as you like.
+ * Function: cargo_leave
+ * Parameters: ai - the aircraft leaving
+ * Returns: void
+ * Description: a simple leave function for the cargo aircraft.
+ *              Releases its slot in the runway state with a
+ *              compare-and-swap, no mutex needed.
+ */
+static void cargo_leave(aircraft_info *ai) 
+{
+  /* 
+   * TODO
+   * YOUR CODE HERE. 
+   */
+  runway_depart(ai);
+}
+
+/* Code executed by an emergency aircraft when leaving the runway.
+ * You need to implement this.  Do not delete the assert() statements,
+ * but feel free to add as many of your own as you like.
+ * Function: emergency_leave
+ * Parameters: ai - the aircraft leaving
+ * Returns: void
+ * Description: a simple leave function for the emergency aircraft.
+ *              Releases its slot in the runway state with a
+ *              compare-and-swap, no mutex needed.
+ */
+static void emergency_leave(aircraft_info *ai) 
+{
+  /* 
+   * TODO
+   * YOUR CODE HERE. 
+   */
+  runway_depart(ai);
+}
+
+/* Main code for commercial aircraft, written as a resumable state machine so
+ * it can run either on its own thread or as a task on the worker pool.
+ * Function: commercial_step
+ * Parameters: ai - pointer to aircraft information structure
+ * Returns: 1 once the aircraft has cleared the runway, 0 while it is
+ *          waiting or on the runway and has to be resumed later
+ */
+static int commercial_step(aircraft_info *ai)
+{
+  runway_view rv;
+
+  if (ai->state == AIRCRAFT_ARRIVING)
+  {
+    /* Record arrival time for fuel tracking */
+    ai->times[LIFE_ARRIVAL] = sim_now();
+  }
+
+  if (ai->state != AIRCRAFT_DEPARTING)
+  {
+    /* Request runway access */
+    if (!commercial_enter(ai))
+    {
+      return 0;
+    }
+
+    rv = runway_snapshot(&ai->runway->state);
+    log_event(LOG_ON_RUNWAY, ai->runway->id, ai->aircraft_id, ai->aircraft_type,
+              rv.direction, log_ms(ai->fuel_reserve));
+
+    assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+    assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+    assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+    assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+    assert(rv.cargo == 0 ); // Commercial and cargo cannot mix
+
+    /* Use runway.  The aircraft resumes in AIRCRAFT_DEPARTING afterwards. */
+    ai->times[LIFE_RUNWAY] = sim_now();
+    log_event(LOG_BEGIN, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1,
+              log_ms(ai->runway_time));
+    ai->state = AIRCRAFT_DEPARTING;
+    use_runway(ai, ai->runway_time);
+    return 0;
+  }
+  log_event(LOG_COMPLETE, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  /* Leave runway */
+  commercial_leave(ai);  
+
+  rv = runway_snapshot(&ai->runway->state);
+  ai->times[LIFE_CLEAR] = sim_now();
+  log_event(LOG_CLEARED, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  if (!(rv.total <= config.max_runway_capacity && rv.total >= 0)) {
+    log_flush();
+    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", rv.total, config.max_runway_capacity);
+    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
+           rv.commercial, rv.cargo, rv.emergency,
+           rv.direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+  assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+  assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+  assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+
+  ai->state = AIRCRAFT_CLEARED;
+  return 1;
+}
+
+/* Main code for cargo aircraft, written as a resumable state machine so
+ * it can run either on its own thread or as a task on the worker pool.
+ * Function: cargo_step
+ * Parameters: ai - pointer to aircraft information structure
+ * Returns: 1 once the aircraft has cleared the runway, 0 while it is
+ *          waiting or on the runway and has to be resumed later
+ */
+static int cargo_step(aircraft_info *ai)
+{
+  runway_view rv;
+
+  if (ai->state == AIRCRAFT_ARRIVING)
+  {
+    /* Record arrival time for fuel tracking */
+    ai->times[LIFE_ARRIVAL] = sim_now();
+  }
+
+  if (ai->state != AIRCRAFT_DEPARTING)
+  {
+    /* Request runway access */
+    if (!cargo_enter(ai))
+    {
+      return 0;
+    }
+
+    rv = runway_snapshot(&ai->runway->state);
+    log_event(LOG_ON_RUNWAY, ai->runway->id, ai->aircraft_id, ai->aircraft_type,
+              rv.direction, log_ms(ai->fuel_reserve));
+
+    if (!(rv.total <= config.max_runway_capacity && rv.total >= 0)) {
+      log_flush();
+      printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", rv.total, 
+              config.max_runway_capacity);
+      printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
+             rv.commercial, rv.cargo, rv.emergency,
+             rv.direction == NORTH ? "NORTH" : "SOUTH");
+    }
+    assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+    assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+    assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+    assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+    assert(rv.commercial == 0 ); 
+
+    ai->times[LIFE_RUNWAY] = sim_now();
+    log_event(LOG_BEGIN, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1,
+              log_ms(ai->runway_time));
+    ai->state = AIRCRAFT_DEPARTING;
+    use_runway(ai, ai->runway_time);
+    return 0;
+  }
+  log_event(LOG_COMPLETE, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  /* Leave runway */
+  cargo_leave(ai);        
+
+  rv = runway_snapshot(&ai->runway->state);
+  ai->times[LIFE_CLEAR] = sim_now();
+  log_event(LOG_CLEARED, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  if (!(rv.total <= config.max_runway_capacity && rv.total >= 0)) {
+    log_flush();
+    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", 
+           rv.total, config.max_runway_capacity);
+    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
+           rv.commercial, rv.cargo, rv.emergency,
+           rv.direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+  assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+  assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+  assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+
+  ai->state = AIRCRAFT_CLEARED;
+  return 1;
+}
+
+/* Main code for emergency aircraft, written as a resumable state machine so
+ * it can run either on its own thread or as a task on the worker pool.
+ * Function: emergency_step
+ * Parameters: ai - pointer to aircraft information structure
+ * Returns: 1 once the aircraft has cleared the runway, 0 while it is
+ *          waiting or on the runway and has to be resumed later
+ */
+static int emergency_step(aircraft_info *ai)
+{
+  runway_view rv;
+
+  if (ai->state == AIRCRAFT_ARRIVING)
+  {
+    /* Record arrival time for fuel and emergency timeout tracking */
+    ai->times[LIFE_ARRIVAL] = sim_now();
+  }
+
+  if (ai->state != AIRCRAFT_DEPARTING)
+  {
+    /* Request runway access */
+    if (!emergency_enter(ai))
+    {
+      return 0;
+    }
+
+    rv = runway_snapshot(&ai->runway->state);
+    log_event(LOG_ON_RUNWAY, ai->runway->id, ai->aircraft_id, ai->aircraft_type,
+              rv.direction, log_ms(ai->fuel_reserve));
+
+    if (!(rv.total <= config.max_runway_capacity && rv.total >= 0)) {
+      log_flush();
+      printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", rv.total, 
+              config.max_runway_capacity);
+      printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
+             rv.commercial, rv.cargo, rv.emergency,
+             rv.direction == NORTH ? "NORTH" : "SOUTH");
+    }
+    assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+    assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+    assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+    assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+
+    ai->times[LIFE_RUNWAY] = sim_now();
+    log_event(LOG_BEGIN, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1,
+              log_ms(ai->runway_time));
+    ai->state = AIRCRAFT_DEPARTING;
+    use_runway(ai, ai->runway_time);
+    return 0;
+  }
+  log_event(LOG_COMPLETE, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  /* Leave runway */
+  emergency_leave(ai);        
+
+  rv = runway_snapshot(&ai->runway->state);
+  ai->times[LIFE_CLEAR] = sim_now();
+  log_event(LOG_CLEARED, ai->runway->id, ai->aircraft_id, ai->aircraft_type, -1, 0);
+
+  if (!(rv.total <= config.max_runway_capacity && rv.total >= 0)) {
+    log_flush();
+    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", 
+           rv.total, config.max_runway_capacity);
+    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
+           rv.commercial, rv.cargo, rv.emergency,
+           rv.direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(rv.total <= config.max_runway_capacity && rv.total >= 0);
+  assert(rv.commercial >= 0 && rv.commercial <= config.max_runway_capacity);
+  assert(rv.cargo >= 0 && rv.cargo <= config.max_runway_capacity);
+  assert(rv.emergency >= 0 && rv.emergency <= config.max_runway_capacity);
+
+  ai->state = AIRCRAFT_CLEARED;
+  return 1;
+}
+
+/* Called once an aircraft has cleared the runway.  Its record goes back
+ * to the arena, so the caller must not touch ai afterwards.  Once the
+ * last aircraft is counted main may stop the log and free the rings, so
+ * an aircraft thread detaches from its ring before.
+ */
+static void aircraft_finished(aircraft_info *ai)
+{
+  lifecycle_record(ai);
+  aircraft_release(ai);
+  pthread_mutex_lock(&Mutex_DONE);
+  aircraft_done++;
+  sim_cond_signal(&Cond_DONE);
+  pthread_mutex_unlock(&Mutex_DONE);
+}
+
+/* Main code for commercial aircraft threads.  
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void* commercial_aircraft(void *ai_ptr) 
+{
+  aircraft_info *ai = (aircraft_info*)ai_ptr;
+
+  while (!commercial_step(ai))
+  {
+    /* each call returns after a wait; go round and re-check */
+  }
+
+  log_detach();
+  aircraft_finished(ai);
+  sim_thread_end();
+  pthread_exit(NULL);
+}
+
+/* Main code for cargo aircraft threads.
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void* cargo_aircraft(void *ai_ptr) 
+{
+  aircraft_info *ai = (aircraft_info*)ai_ptr;
+
+  while (!cargo_step(ai))
+  {
+    /* each call returns after a wait; go round and re-check */
+  }
+
+  log_detach();
+  aircraft_finished(ai);
+  sim_thread_end();
+  pthread_exit(NULL);
+}
+
+/* Main code for emergency aircraft threads.
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void* emergency_aircraft(void *ai_ptr) 
+{
+  aircraft_info *ai = (aircraft_info*)ai_ptr;
+
+  while (!emergency_step(ai))
+  {
+    /* each call returns after a wait; go round and re-check */
+  }
+
+  log_detach();
+  aircraft_finished(ai);
+  sim_thread_end();
+  pthread_exit(NULL);
+}
+
+/* Pool task for one aircraft.  Runs the aircraft until it has to wait and
+ * counts it as finished once it has cleared the runway.
+ */
+static void aircraft_task(void *arg)
+{
+  aircraft_info *ai = (aircraft_info*)arg;
+  int done;
+
+  if (ai->aircraft_type == COMMERCIAL)
+  {
+    done = commercial_step(ai);
+  }
+  else if (ai->aircraft_type == CARGO)
+  {
+    done = cargo_step(ai);
+  }
+  else
+  {
+    done = emergency_step(ai);
+  }
+
+  if (done)
+  {
+    aircraft_finished(ai);
+  }
+}
+
+/* Fuel emergencies over all runways. */
+static long count_fuel_emergencies()
+{
+  long n = 0;
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+    n += runways[i].fuel_emergencies;
+  return n;
+}
+
+/* Direction switches over all runways. */
+static long count_switches()
+{
+  long switches = 0;
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+    switches += runways[i].switches;
+  return switches;
+}
+
+/* Runway dead time over all runways, see controller_pause(). */
+static sim_time_t count_dead_time()
+{
+  sim_time_t dead = 0;
+  int i;
+
+  for (i = 0; i < runway_count; i++)
+    dead += runways[i].dead_time;
+  return dead;
+}
+
+/* Append every runway's wait samples of each type to waits[type]. */
+static void collect_waits(sample_vec waits[3])
+{
+  int i, type;
+  long j;
+
+  for (i = 0; i < runway_count; i++)
+    for (type = 0; type < 3; type++)
+      for (j = 0; j < runways[i].waits[type].count; j++)
+        sample_push(&waits[type], runways[i].waits[type].items[j]);
+}
+
+/* Summary printed at the end of the simulation with --stats.
+ */
+static void print_report()
+{
+  struct timespec cpu;
+  long wakeups = 0, passes = 0, notifies = 0, notify_locks = 0;
+  sim_time_t latency_total = 0, latency_max = 0;
+  int queue_peak = 0;
+  int i;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+  for (i = 0; i < runway_count; i++)
+  {
+    runway_info *r = &runways[i];
+
+    wakeups += r->controller_wakeups;
+    passes += r->controller_passes;
+    notifies += r->controller_notifies;
+    notify_locks += r->controller_notify_locks;
+    latency_total += r->controller_latency_total;
+    if (r->controller_latency_max > latency_max)
+      latency_max = r->controller_latency_max;
+    if (r->queue_peak > queue_peak)
+      queue_peak = r->queue_peak;
+  }
+
+  printf("\n=== Runway statistics ===\n");
+  printf("Scheduling policy:           %s\n", policy->name);
+  printf("Controller evaluations:      %ld\n", passes);
+  printf("Controller wake-ups:         %ld\n", wakeups);
+  printf("Event to wake-up latency:    avg %.3f ms, max %.3f ms\n",
+         wakeups ? (double)latency_total / wakeups / 1e6 : 0.0,
+         (double)latency_max / 1e6);
+  printf("Controller notifications:    %ld (%ld took the controller lock)\n",
+         notifies, notify_locks);
+  printf("Runway CAS retries:          %ld\n", runway_cas_retries);
+  printf("Peak wait queue length:      %d\n", queue_peak);
+  printf("Aircraft records allocated:  %ld\n", arena_records);
+  if (log_mode != LOG_OFF)
+    printf("Event log full-ring waits:   %ld\n", log_full_waits);
+  printf("Makespan:                    %.3f s with %d runway%s\n",
+         (double)makespan / NSEC_PER_SEC, runway_count, runway_count > 1 ? "s" : "");
+  if (streaming)
+    printf("Stream backpressure:         %ld stalls at %d waiting, %.3f s in total\n",
+           backlog_stalls, config.backlog, (double)backlog_stalled / NSEC_PER_SEC);
+  for (i = 0; i < runway_count; i++)
+  {
+    runway_info *r = &runways[i];
+
+    printf("Runway %d:                    %ld landings, %.1f%% busy, %ld switches, "
+           "%ld holds, %ld breaks (%ld during switches, %ld idle), %ld stolen\n",
+           i, r->landings, makespan ? 100.0 * r->busy_total / makespan : 0.0,
+           r->switches, r->holds, r->breaks, r->breaks_overlapped, r->breaks_idle, r->stolen);
+  }
+  printf("Runway dead time:            %.3f s with aircraft waiting on a break or switch\n",
+         (double)count_dead_time() / NSEC_PER_SEC);
+  printf("Fuel emergencies:            %ld\n", count_fuel_emergencies());
+  if (watchdog_seconds > 0)
+    printf("Watchdog:                    %ld stalls, %ld starving aircraft reported\n",
+           watchdog_stalls, watchdog_starving);
+  printf("Process CPU time:            %.3f s\n",
+         cpu.tv_sec + cpu.tv_nsec / 1e9);
+  print_lifecycle_report();
+}
+
+/* Play the scenario in filename, or the --generate one if filename is
+ * NULL, once: start the controllers, release the aircraft at their
+ * arrival times and wait until all of them have cleared the runway.  The
+ * runways are left for print_report() to read.
+ */
+static void run_simulation(char *filename, int use_virtual_time, int workers)
+{
+  int i;
+  int result;
+  int num_aircraft;
+  void *status;
+  pthread_t aircraft_tid;
+  pthread_attr_t aircraft_attr;
+  scenario_reader scenario;
+  forecast_queue forecast;
+  aircraft_info *ai;
+  sim_time_t wait;
+
+  /* a replica forked after a run starts from that run's counters */
+  aircraft_done = 0;
+  controller_shutdown = 0;
+  arrivals_pending = 0;
+  makespan = 0;
+  sim_clock_init(use_virtual_time);
+
+  num_aircraft = initialize(&scenario, filename);
+  streaming = scenario.kind == SCENARIO_STREAM;
+  backlog_stalls = 0;
+  backlog_stalled = 0;
+  if (num_aircraft <= 0 && !streaming)
+  {
+    printf("Error:  Bad number of aircraft threads. "
+           "Maybe there was a problem with your input file?\n");
+    exit(1);
+  }
+  if (schedule_mode == SCHEDULE_REPLAY && streaming)
+  {
+    printf("runway: --replay needs the scenario it was recorded with as a file, %s is a stream\n",
+           filename);
+    exit(1);
+  }
+  if (!streaming && lifecycle_reserve(num_aircraft) != 0)
+  {
+    printf("runway: out of memory allocating lifecycle records for %d aircraft\n", num_aircraft);
+    exit(1);
+  }
+  if (schedule_mode == SCHEDULE_REPLAY && num_aircraft != replay_aircraft_count)
+  {
+    printf("runway: %s was recorded with %lld aircraft, the scenario has %d\n",
+           schedule_path, replay_aircraft_count, num_aircraft);
+    exit(1);
+  }
+
+  if (streaming)
+    printf("Starting runway simulation with aircraft from %s ...\n", filename);
+  else
+    printf("Starting runway simulation with %d aircraft ...\n", num_aircraft);
+  live_open(num_aircraft);
+  log_start();
+
+  for (i = 0; i < runway_count; i++)
+  {
+    sim_thread_begin();
+    result = pthread_create(&runways[i].controller_tid, NULL, controller_thread, &runways[i]);
+
+    if (result)
+    {
+      printf("runway:  pthread_create failed for controller: %s\n", strerror(result));
+      exit(1);
+    }
+  }
+
+  if (workers > 0)
+  {
+    sim_pool_start(workers);
+  }
+  watchdog_start();
+
+  /* Aircraft threads are never joined; completion is counted in
+   * aircraft_finished() instead.
+   */
+  pthread_attr_init(&aircraft_attr);
+  pthread_attr_setdetachstate(&aircraft_attr, PTHREAD_CREATE_DETACHED);
+
+  forecast_init(&forecast, &scenario);
+  for (i=0; (ai = forecast_peek(&forecast)) != NULL; i++) 
+  {
+    wait = forecast_due_next(&forecast) - sim_now();
+    if (wait > 0)
+      sim_sleep(wait);
+    /* only a stream's count is not known up front */
+    if (i >= lifecycle_capacity && lifecycle_reserve((long)i + 1) != 0)
+    {
+      printf("runway: out of memory allocating lifecycle records after %d aircraft\n", i);
+      exit(1);
+    }
+    __atomic_fetch_add(&arrivals_pending, 1, __ATOMIC_RELAXED);
+    forecast_pop(&forecast);
+    ai->aircraft_id = i;
+    live_arrival(i + 1);
+    if (schedule_mode == SCHEDULE_REPLAY)
+      __atomic_store_n(&replay_aircraft[i], ai, __ATOMIC_RELEASE);
+
+    if (workers > 0)
+    {
+      sim_spawn(&ai->task, aircraft_task, ai);
+      continue;
+    }
+                
+    sim_thread_begin();
+    if (ai->aircraft_type == COMMERCIAL)
+    {
+      result = pthread_create(&aircraft_tid, &aircraft_attr, commercial_aircraft, 
+                             (void *)ai);
+    }
+    else if (ai->aircraft_type == CARGO)
+    {
+      result = pthread_create(&aircraft_tid, &aircraft_attr, cargo_aircraft, 
+                             (void *)ai);
+    }
+    else 
+    {
+      result = pthread_create(&aircraft_tid, &aircraft_attr, emergency_aircraft, 
+                             (void *)ai);
+    }
+
+    if (result) 
+    {
+      printf("runway: pthread_create failed for aircraft %d: %s\n", 
+            i, strerror(result));
+      exit(1);
+    }
+  }
+
+  lifecycle_count = i;
+  scenario_close(&scenario);
+  pthread_attr_destroy(&aircraft_attr);
+
+  /* wait for all aircraft to finish, then stop taking part in the
+   * simulation before blocking in pthread_join() so that the virtual
+   * clock can keep moving.
+   */
+  pthread_mutex_lock(&Mutex_DONE);
+  while (aircraft_done < i)
+  {
+    sim_cond_wait(&Cond_DONE, &Mutex_DONE);
+  }
+  pthread_mutex_unlock(&Mutex_DONE);
+  makespan = sim_now();
+  sim_thread_end();
+  watchdog_stop();
+
+  /* tell the controllers to finish. */
+  __atomic_store_n(&controller_shutdown, 1, __ATOMIC_SEQ_CST);
+  for (i = 0; i < runway_count; i++)
+  {
+    pthread_mutex_lock(&runways[i].controller_mutex);
+    sim_cond_signal(&runways[i].controller_cond);
+    pthread_mutex_unlock(&runways[i].controller_mutex);
+  }
+  for (i = 0; i < runway_count; i++)
+  {
+    pthread_join(runways[i].controller_tid, &status);
+  }
+
+  if (workers > 0)
+  {
+    sim_pool_stop();
+  }
+
+  log_stop();
+  live_close();
+  printf("Runway simulation done.\n");
+}
+
+/* Results of one --trials or --sweep replica, written by the child
+ * process to its result file and followed by the wait samples of each
+ * type.
+ */
+typedef struct
+{
+  long aircraft;            /* aircraft that cleared the runway */
+  long fuel_emergencies;
+  long switches;            /* direction switches over all runways */
+  sim_time_t dead_time;     /* runway dead time over all runways */
+  sim_time_t makespan;
+  long waits[3];            /* number of wait samples of each type */
+} trial_result;
+
+/* Body of a replica, run in a child process with its own copy of the
+ * simulation state: play the scenario in virtual time and write the
+ * outcome to out.  Never returns.
+ */
+static void run_trial(char *filename, int workers, FILE *out)
+{
+  sample_vec waits[3] = { { NULL, 0, 0 }, { NULL, 0, 0 }, { NULL, 0, 0 } };
+  trial_result tr;
+  int devnull;
+  int type;
+
+  /* the replicas' own progress messages would only interleave */
+  devnull = open("/dev/null", O_WRONLY);
+  if (devnull >= 0)
+  {
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+  }
+
+  record_waits = 1;
+  log_mode = LOG_OFF;
+  schedule_mode = SCHEDULE_OFF;
+  live_name = NULL;
+  run_simulation(filename, 1, workers);
+  collect_waits(waits);
+
+  tr.aircraft = aircraft_done;
+  tr.fuel_emergencies = count_fuel_emergencies();
+  tr.switches = count_switches();
+  tr.dead_time = count_dead_time();
+  tr.makespan = makespan;
+  for (type = 0; type < 3; type++)
+    tr.waits[type] = waits[type].count;
+  fwrite(&tr, sizeof(tr), 1, out);
+  for (type = 0; type < 3; type++)
+    if (waits[type].count > 0)
+      fwrite(waits[type].items, sizeof(double), waits[type].count, out);
+  fflush(out);
+  fflush(stdout);
+  _exit(ferror(out) ? 1 : 0);
+}
+
+/* Number of replicas run_replicas() keeps going at once. */
+static int replica_jobs(int count)
+{
+  int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (jobs < 1)
+    jobs = 1;
+  return jobs > count ? count : jobs;
+}
+
+/*
+ * Function: run_replicas
+ * Parameters: filename - scenario to replay, NULL for --generate
+ *             count - number of replicas
+ *             workers - --pool workers per replica, 0 for threads
+ *             setup - called in the child with the replica number
+ *                     before the replica runs
+ * Returns: count result files, rewound, with NULL for every replica
+ *          that failed; NULL if filename cannot be read
+ * Description: The simulator keeps its state in globals, so each replica
+ * is a forked child with a private copy.  Up to replica_jobs() replicas
+ * run at a time and each hands its results back through an anonymous
+ * temporary file, see run_trial().
+ */
+static FILE **run_replicas(char *filename, int count, int workers, void (*setup)(int))
+{
+  int jobs = replica_jobs(count);
+  FILE **results;
+  pid_t *pids;
+  pid_t pid;
+  int running = 0, started = 0;
+  int status;
+  int i;
+  FILE *fp;
+
+  /* catch a bad file name once rather than in every replica */
+  if (filename != NULL && (fp = fopen(filename, "r")) == NULL)
+  {
+    printf("Cannot open input file %s for reading.\n", filename);
+    return NULL;
+  }
+  if (filename != NULL)
+    fclose(fp);
+
+  results = calloc(count, sizeof(*results));
+  pids = calloc(count, sizeof(*pids));
+  if (results == NULL || pids == NULL)
+  {
+    printf("runway: out of memory starting replicas\n");
+    exit(1);
+  }
+  fflush(stdout);
+
+  while (started < count || running > 0)
+  {
+    while (running < jobs && started < count)
+    {
+      if ((results[started] = tmpfile()) == NULL)
+      {
+        printf("runway: cannot create a result file: %s\n", strerror(errno));
+        exit(1);
+      }
+      pid = fork();
+      if (pid < 0)
+      {
+        printf("runway: fork failed: %s\n", strerror(errno));
+        exit(1);
+      }
+      if (pid == 0)
+      {
+        setup(started);
+        run_trial(filename, workers, results[started]);
+      }
+      pids[started++] = pid;
+      running++;
+    }
+
+    pid = wait(&status);
+    if (pid < 0)
+    {
+      printf("runway: wait failed: %s\n", strerror(errno));
+      exit(1);
+    }
+    running--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      for (i = 0; i < started && pids[i] != pid; i++)
+        ;
+      fclose(results[i]);
+      results[i] = NULL;
+    }
+  }
+
+  for (i = 0; i < count; i++)
+    if (results[i] != NULL)
+      rewind(results[i]);
+  free(pids);
+  return results;
+}
+
+/* Read a replica's results from fp: the trial_result, and its wait
+ * samples appended to waits.  Returns 0 if fp is NULL or cut short.
+ */
+static int read_trial(FILE *fp, trial_result *tr, sample_vec waits[3])
+{
+  double x;
+  long j;
+  int type;
+
+  if (fp == NULL || fread(tr, sizeof(*tr), 1, fp) != 1)
+    return 0;
+  for (type = 0; type < 3; type++)
+  {
+    for (j = 0; j < tr->waits[type]; j++)
+    {
+      if (fread(&x, sizeof(x), 1, fp) != 1)
+        return 0;
+      sample_push(&waits[type], x);
+    }
+  }
+  return 1;
+}
+
+/* Each replica of --trials draws its own fuel reserves. */
+static void trial_setup(int trial)
+{
+  fuel_seed += trial;
+}
+
+/* The tables of --sweep and --compare-policies and the comparisons of
+ * --stats run every setting (a cell) as cell_trials replicas, replica i
+ * playing trial i % cell_trials of cell i / cell_trials.  Like --trials,
+ * trial t uses fuel seed fuel_seed + t, so every cell sees the same fuel
+ * reserves, and the cells are compared by mean and spread over their
+ * trials rather than by one run each.
+ */
+#define CELL_TRIALS 5            /* replicas per cell without --trials */
+
+static int cell_trials = CELL_TRIALS;
+
+/* What the trials of one cell measured, one sample per trial. */
+typedef struct
+{
+  sample_vec makespan;           /* s */
+  sample_vec throughput;         /* aircraft per hour */
+  sample_vec wait_p99;           /* s, over all aircraft types */
+  sample_vec type_p50[3];        /* s */
+  sample_vec type_p99[3];        /* s */
+  sample_vec fuel_emergencies;
+  sample_vec switches;
+  sample_vec dead_time;          /* s */
+} cell_summary;
+
+/* Read the cell_trials results of a cell starting at results, closing
+ * them.  Returns the number of trials that failed.
+ */
+static int cell_read(FILE **results, cell_summary *c)
+{
+  sample_vec waits[3];
+  trial_result tr;
+  int failed = 0;
+  int i, type;
+  long k;
+
+  memset(c, 0, sizeof(*c));
+  for (i = 0; i < cell_trials; i++)
+  {
+    memset(waits, 0, sizeof(waits));
+    if (!read_trial(results[i], &tr, waits))
+    {
+      failed++;
+    }
+    else
+    {
+      sample_push(&c->makespan, (double)tr.makespan / NSEC_PER_SEC);
+      sample_push(&c->throughput,
+                  tr.makespan ? tr.aircraft * 3600.0 * NSEC_PER_SEC / tr.makespan : 0.0);
+      for (type = 0; type < 3; type++)
+      {
+        qsort(waits[type].items, waits[type].count, sizeof(double), sample_compare);
+        sample_push(&c->type_p50[type], sample_percentile(&waits[type], 0.50));
+        sample_push(&c->type_p99[type], sample_percentile(&waits[type], 0.99));
+      }
+      /* one sample vector over all types for the p99 */
+      for (type = 1; type < 3; type++)
+        for (k = 0; k < waits[type].count; k++)
+          sample_push(&waits[0], waits[type].items[k]);
+      qsort(waits[0].items, waits[0].count, sizeof(double), sample_compare);
+      sample_push(&c->wait_p99, sample_percentile(&waits[0], 0.99));
+      sample_push(&c->fuel_emergencies, tr.fuel_emergencies);
+      sample_push(&c->switches, tr.switches);
+      sample_push(&c->dead_time, (double)tr.dead_time / NSEC_PER_SEC);
+    }
+    for (type = 0; type < 3; type++)
+      free(waits[type].items);
+    if (results[i] != NULL)
+      fclose(results[i]);
+  }
+  return failed;
+}
+
+static void cell_free(cell_summary *c)
+{
+  int type;
+
+  free(c->makespan.items);
+  free(c->throughput.items);
+  free(c->wait_p99.items);
+  for (type = 0; type < 3; type++)
+  {
+    free(c->type_p50[type].items);
+    free(c->type_p99[type].items);
+  }
+  free(c->fuel_emergencies.items);
+  free(c->switches.items);
+  free(c->dead_time.items);
+}
+
+/*
+ * Function: run_trials
+ * Parameters: filename - scenario to replay, NULL for --generate
+ *             trials - number of replicas
+ *             workers - --pool workers per replica, 0 for threads
+ * Returns: 0 on success, 1 if a replica failed
+ * Description: Monte Carlo mode.  Every replica plays the same scenario
+ * in virtual time with its own fuel seed (fuel_seed + trial number).
+ * With --generate the seed also draws the scenario, so every replica
+ * gets its own sample of the workload.  The replicas run in parallel,
+ * see run_replicas(), and the parent then prints distributions of fuel
+ * emergencies, makespan and wait times over all of them.
+ */
+static int run_trials(char *filename, int trials, int workers)
+{
+  sample_vec emergencies = { NULL, 0, 0 };
+  sample_vec makespans = { NULL, 0, 0 };
+  sample_vec waits[3] = { { NULL, 0, 0 }, { NULL, 0, 0 }, { NULL, 0, 0 } };
+  unsigned long long base_seed = fuel_seed;
+  FILE **results;
+  trial_result tr;
+  char label[32];
+  long with_emergency = 0;
+  int failed = 0;
+  int i, type;
+
+  printf("Running %d trials of %s on %d processes (seeds %llu to %llu) ...\n",
+         trials, filename ? filename : "a generated scenario", replica_jobs(trials),
+         base_seed, base_seed + trials - 1);
+  if ((results = run_replicas(filename, trials, workers, trial_setup)) == NULL)
+    return 1;
+
+  for (i = 0; i < trials; i++)
+  {
+    if (!read_trial(results[i], &tr, waits))
+    {
+      printf("runway: trial %d (seed %llu) failed\n", i, base_seed + i);
+      failed++;
+    }
+    else
+    {
+      sample_push(&emergencies, tr.fuel_emergencies);
+      sample_push(&makespans, (double)tr.makespan / NSEC_PER_SEC);
+      if (tr.fuel_emergencies > 0)
+        with_emergency++;
+    }
+    if (results[i] != NULL)
+      fclose(results[i]);
+  }
+
+  printf("\n=== Monte Carlo over %ld trials ===\n", makespans.count);
+  print_distribution("Fuel emergencies per trial:", &emergencies);
+  printf("Trials with a fuel emergency: %.1f%%\n",
+         makespans.count ? 100.0 * with_emergency / makespans.count : 0.0);
+  print_distribution("Makespan (s):", &makespans);
+  for (type = 0; type < 3; type++)
+  {
+    snprintf(label, sizeof(label), "Wait %s (s):", type_names[type]);
+    print_distribution(label, &waits[type]);
+    free(waits[type].items);
+  }
+
+  free(emergencies.items);
+  free(makespans.items);
+  free(results);
+  return failed ? 1 : 0;
+}
+
+/*** Parameter sweep ***/
+
+/* --sweep=NAME=VALUES varies a parameter of config; given several times
+ * the replicas cover every combination of the values, the last parameter
+ * varying fastest.
+ */
+#define SWEEP_PARAMS 8           /* parameters that can be swept at once */
+#define SWEEP_VALUES 256         /* values per parameter */
+#define SWEEP_MAX    100000      /* combinations */
+
+typedef struct
+{
+  int param;                /* index into config_params */
+  int count;
+  int values[SWEEP_VALUES];
+} sweep_axis;
+
+static sweep_axis sweep_axes[SWEEP_PARAMS];
+static int sweep_count = 0;              /* parameters given with --sweep */
+
+/* Parse "NAME=VALUES" for --sweep, VALUES being a comma separated list of
+ * numbers and FIRST:LAST or FIRST:LAST:STEP ranges.  Returns 0 on success,
+ * EINVAL after printing what is wrong.
+ */
+static int sweep_add(char *arg)
+{
+  sweep_axis *ax = &sweep_axes[sweep_count];
+  char *value = strchr(arg, '=');
+  char *item;
+  int first, last, step, n;
+
+  if (sweep_count == SWEEP_PARAMS)
+  {
+    printf("runway: at most %d parameters can be swept\n", SWEEP_PARAMS);
+    return EINVAL;
+  }
+  if (value == NULL)
+  {
+    printf("runway: --sweep needs NAME=VALUES\n");
+    return EINVAL;
+  }
+  *value++ = '\0';
+  if ((ax->param = config_find(arg)) < 0)
+    return EINVAL;
+
+  ax->count = 0;
+  for (item = strtok(value, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    step = 1;
+    if (sscanf(item, "%d:%d:%d%n", &first, &last, &step, &n) == 3 && item[n] == '\0')
+      ;
+    else if (sscanf(item, "%d:%d%n", &first, &last, &n) == 2 && item[n] == '\0')
+      ;
+    else if (sscanf(item, "%d%n", &first, &n) == 1 && item[n] == '\0')
+      last = first;
+    else
+      step = 0;
+    if (step <= 0 || last < first)
+    {
+      printf("runway: bad --sweep value %s for %s\n", item, arg);
+      return EINVAL;
+    }
+    for (; first <= last; first += step)
+    {
+      if (config_check_value(ax->param, first) != 0)
+        return EINVAL;
+      if (ax->count == SWEEP_VALUES)
+      {
+        printf("runway: at most %d values can be swept for %s\n", SWEEP_VALUES, arg);
+        return EINVAL;
+      }
+      ax->values[ax->count++] = first;
+      if (first > INT_MAX - step)
+        break;
+    }
+  }
+  if (ax->count == 0)
+  {
+    printf("runway: --sweep=%s has no values\n", arg);
+    return EINVAL;
+  }
+  sweep_count++;
+  return 0;
+}
+
+/* Set config to combination number combo of the sweep grid. */
+static void sweep_setup(int combo)
+{
+  int i;
+
+  for (i = sweep_count - 1; i >= 0; i--)
+  {
+    *config_params[sweep_axes[i].param].value = sweep_axes[i].values[combo % sweep_axes[i].count];
+    combo /= sweep_axes[i].count;
+  }
+}
+
+/* Replica i of run_sweep() plays a trial of combination i / cell_trials. */
+static void sweep_replica_setup(int i)
+{
+  sweep_setup(i / cell_trials);
+  trial_setup(i % cell_trials);
+}
+
+/* Width of parameter k's column in the sweep table. */
+static int sweep_width(int k)
+{
+  int width = (int)strlen(config_params[sweep_axes[k].param].name);
+
+  return width < 6 ? 6 : width;
+}
+
+/* Replica i of run_comparison() plays a trial under policy i / cell_trials. */
+static void policy_setup(int i)
+{
+  policy = &policies[i / cell_trials];
+  trial_setup(i % cell_trials);
+}
+
+/*
+ * Function: run_comparison
+ * Parameters: filename - scenario to replay, NULL for --generate
+ *             trials - replicas per policy
+ *             workers - --pool workers per replica, 0 for threads
+ * Returns: 0 on success, 1 if a replica failed
+ * Description: Play the scenario trials times under every scheduling
+ * policy, in parallel replicas on the virtual clock, trial t of every
+ * policy with seed + t, and print the mean and standard deviation over
+ * the trials of makespan, throughput and the p50/p99 waits of each
+ * aircraft type side by side.
+ */
+static int run_comparison(char *filename, int trials, int workers)
+{
+  cell_summary cell;
+  FILE **results;
+  int failed = 0;
+  int i, type;
+
+  cell_trials = trials;
+  printf("Comparing %d policies on %s, %d trials each, on %d processes (seeds %llu to %llu) ...\n",
+         POLICIES, filename ? filename : "a generated scenario", trials,
+         replica_jobs(POLICIES * trials), fuel_seed, fuel_seed + trials - 1);
+  if ((results = run_replicas(filename, POLICIES * trials, workers, policy_setup)) == NULL)
+    return 1;
+
+  printf("\n=== Policies (mean ± sd over %d trials) ===\n", trials);
+  printf("%-9s %16s %16s", "policy", "makespan (s)", "aircraft/h");
+  for (type = 0; type < 3; type++)
+    printf(" %12.12s p50 %12.12s p99", type_names[type], type_names[type]);
+  printf(" %16s %16s\n", "fuel outs", "switches");
+
+  for (i = 0; i < POLICIES; i++)
+  {
+    printf("%-9s", policies[i].name);
+    failed += cell_read(results + i * trials, &cell);
+    if (cell.makespan.count == 0)
+    {
+      printf(" failed\n");
+    }
+    else
+    {
+      print_spread(16, &cell.makespan);
+      print_spread(16, &cell.throughput);
+      for (type = 0; type < 3; type++)
+      {
+        print_spread(16, &cell.type_p50[type]);
+        print_spread(16, &cell.type_p99[type]);
+      }
+      print_spread(16, &cell.fuel_emergencies);
+      print_spread(16, &cell.switches);
+      if (cell.makespan.count < trials)
+        printf(" (%ld of %d trials)", cell.makespan.count, trials);
+      printf("\n");
+    }
+    cell_free(&cell);
+  }
+
+  free(results);
+  return failed ? 1 : 0;
+}
+
+/* The first cell of print_planner_report() plays with the planner, the
+ * second without it.
+ */
+static void planner_off_setup(int replica)
+{
+  trial_setup(replica % cell_trials);
+  if (replica >= cell_trials)
+    config.lookahead = 0;
+}
+
+/*
+ * Function: print_planner_report
+ * Parameters: filename - the scenario just played, NULL for --generate
+ *             workers - --pool workers, 0 for threads
+ * Returns: void
+ * Description: Part of --stats when the direction planner is on.  One
+ * run says little, since its switches depend on how the threads
+ * interleave, so the scenario is played CELL_TRIALS times in virtual
+ * time with the planner and as often by replicas that only react
+ * (lookahead 0), trial t of both with seed + t.  The switch time the
+ * planner saved is the difference of the mean switches times the
+ * switch time.
+ */
+static void print_planner_report(char *filename, int workers)
+{
+  cell_summary planned, reactive;
+  FILE **results;
+  int failed;
+
+  cell_trials = CELL_TRIALS;
+  if ((results = run_replicas(filename, 2 * cell_trials, workers, planner_off_setup)) == NULL)
+    return;
+  failed = cell_read(results, &planned);
+  failed += cell_read(results + cell_trials, &reactive);
+  if (failed)
+  {
+    printf("runway: %d of the planner replicas failed\n", failed);
+  }
+  else
+  {
+    printf("Direction planner:           %.1f ± %.1f switches, reactive policy %.1f ± %.1f "
+           "over %d trials, %.1f s of switching saved\n",
+           sample_mean(&planned.switches), sample_sd(&planned.switches),
+           sample_mean(&reactive.switches), sample_sd(&reactive.switches), cell_trials,
+           (sample_mean(&reactive.switches) - sample_mean(&planned.switches))
+           * config.direction_switch_time);
+    printf("                             makespan %.3f ± %.3f s, reactive policy %.3f ± %.3f s\n",
+           sample_mean(&planned.makespan), sample_sd(&planned.makespan),
+           sample_mean(&reactive.makespan), sample_sd(&reactive.makespan));
+  }
+  cell_free(&planned);
+  cell_free(&reactive);
+  free(results);
+}
+
+/* The first cell of print_breaks_report() plays with early breaks, the
+ * second only takes breaks when they are due.
+ */
+static void early_breaks_off_setup(int replica)
+{
+  trial_setup(replica % cell_trials);
+  if (replica >= cell_trials)
+    config.early_breaks = 0;
+}
+
+/*
+ * Function: print_breaks_report
+ * Parameters: filename - the scenario just played, NULL for --generate
+ *             workers - --pool workers, 0 for threads
+ * Returns: void
+ * Description: Part of --stats when early breaks are on.  Like
+ * print_planner_report(), the scenario is played CELL_TRIALS times in
+ * virtual time with early breaks and as often taking every break only
+ * once controller-limit aircraft have been handled, trial t of both
+ * with seed + t.  The runway dead time recovered is the difference of
+ * the mean dead times.
+ */
+static void print_breaks_report(char *filename, int workers)
+{
+  cell_summary early, due;
+  FILE **results;
+  int failed;
+
+  cell_trials = CELL_TRIALS;
+  if ((results = run_replicas(filename, 2 * cell_trials, workers, early_breaks_off_setup)) == NULL)
+    return;
+  failed = cell_read(results, &early);
+  failed += cell_read(results + cell_trials, &due);
+  if (failed)
+  {
+    printf("runway: %d of the early break replicas failed\n", failed);
+  }
+  else
+  {
+    printf("Early breaks:                %.3f ± %.3f s dead time, breaks only when due "
+           "%.3f ± %.3f s over %d trials, %.3f s recovered\n",
+           sample_mean(&early.dead_time), sample_sd(&early.dead_time),
+           sample_mean(&due.dead_time), sample_sd(&due.dead_time), cell_trials,
+           sample_mean(&due.dead_time) - sample_mean(&early.dead_time));
+    printf("                             makespan %.3f ± %.3f s, breaks only when due %.3f ± %.3f s\n",
+           sample_mean(&early.makespan), sample_sd(&early.makespan),
+           sample_mean(&due.makespan), sample_sd(&due.makespan));
+  }
+  cell_free(&early);
+  cell_free(&due);
+  free(results);
+}
+
+/*
+ * Function: run_sweep
+ * Parameters: filename - scenario to replay, NULL for --generate
+ *             trials - replicas per combination
+ *             workers - --pool workers per replica, 0 for threads
+ * Returns: 0 on success, EINVAL for a bad grid, 1 if a replica failed
+ * Description: Play the scenario trials times for every combination of
+ * the --sweep values, in parallel like --trials, and print a table of
+ * the mean and standard deviation over the trials of makespan,
+ * throughput, p99 wait over all aircraft types, fuel emergencies and
+ * switches.  Trial t of every combination uses the same seed, so the
+ * combinations see the same fuel reserves.  The combination with the
+ * highest mean throughput is named at the end, ties going to the lower
+ * mean p99 wait.
+ */
+static int run_sweep(char *filename, int trials, int workers)
+{
+  sim_config defaults = config;
+  cell_summary cell;
+  FILE **results;
+  double throughput, p99;
+  double best_throughput = -1.0, best_p99 = 0.0;
+  int best = -1;
+  int combos = 1;
+  int failed = 0;
+  int i, k;
+
+  for (k = 0; k < sweep_count; k++)
+  {
+    if (combos > SWEEP_MAX / sweep_axes[k].count)
+    {
+      printf("runway: the sweep has more than %d combinations\n", SWEEP_MAX);
+      return EINVAL;
+    }
+    combos *= sweep_axes[k].count;
+  }
+  if (combos > INT_MAX / trials)
+  {
+    printf("runway: the sweep needs more than %d replicas\n", INT_MAX);
+    return EINVAL;
+  }
+  for (i = 0; i < combos; i++)
+  {
+    sweep_setup(i);
+    if (config_check() != 0)
+      return EINVAL;
+  }
+  config = defaults;
+
+  cell_trials = trials;
+  printf("Sweeping %d combinations of %s, %d trials each, on %d processes (seeds %llu to %llu) ...\n",
+         combos, filename ? filename : "a generated scenario", trials,
+         replica_jobs(combos * trials), fuel_seed, fuel_seed + trials - 1);
+  if ((results = run_replicas(filename, combos * trials, workers, sweep_replica_setup)) == NULL)
+    return 1;
+
+  printf("\n=== Sweep (mean ± sd over %d trials) ===\n", trials);
+  for (k = 0; k < sweep_count; k++)
+    printf("%*s ", sweep_width(k), config_params[sweep_axes[k].param].name);
+  printf(" %16s %16s %16s %16s %16s\n", "makespan (s)", "aircraft/h", "p99 wait (s)",
+         "fuel outs", "switches");
+
+  for (i = 0; i < combos; i++)
+  {
+    sweep_setup(i);
+    for (k = 0; k < sweep_count; k++)
+      printf("%*d ", sweep_width(k), *config_params[sweep_axes[k].param].value);
+
+    failed += cell_read(results + i * trials, &cell);
+    if (cell.makespan.count == 0)
+    {
+      printf("failed\n");
+    }
+    else
+    {
+      print_spread(16, &cell.makespan);
+      print_spread(16, &cell.throughput);
+      print_spread(16, &cell.wait_p99);
+      print_spread(16, &cell.fuel_emergencies);
+      print_spread(16, &cell.switches);
+      if (cell.makespan.count < trials)
+        printf(" (%ld of %d trials)", cell.makespan.count, trials);
+      printf("\n");
+      throughput = sample_mean(&cell.throughput);
+      p99 = sample_mean(&cell.wait_p99);
+      if (throughput > best_throughput || (throughput == best_throughput && p99 < best_p99))
+      {
+        best = i;
+        best_throughput = throughput;
+        best_p99 = p99;
+      }
+    }
+    cell_free(&cell);
+  }
+
+  if (best >= 0)
+  {
+    sweep_setup(best);
+    printf("Highest throughput:");
+    for (k = 0; k < sweep_count; k++)
+      printf(" %s=%d", config_params[sweep_axes[k].param].name,
+             *config_params[sweep_axes[k].param].value);
+    printf(" (%.1f aircraft/h, p99 wait %.1f s)\n", best_throughput, best_p99);
+  }
+  config = defaults;
+
+  free(results);
+  return failed ? 1 : 0;
+}
+
+/*
+ * Function: write_scenario
+ * Parameters: filename - scenario to convert, NULL for --generate
+ *             path - where to write the binary scenario
+ * Returns: 0 on success, 1 if path could not be written
+ * Description: Convert a scenario to the binary format of
+ * runway_scenario.h.  Fuel reserves drawn by the generator are written
+ * as fixed fuel; those of a text file stay random, so the binary file
+ * plays exactly like the text one.
+ */
+static int write_scenario(char *filename, char *path)
+{
+  scenario_reader scenario;
+  scenario_header header;
+  scenario_record rec;
+  aircraft_info *ai;
+  FILE *out;
+  int failed;
+
+  initialize(&scenario, filename);
+  if ((out = fopen(path, "wb")) == NULL)
+  {
+    printf("Cannot open output file %s for writing.\n", path);
+    return 1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memset(&rec, 0, sizeof(rec));
+  memcpy(header.magic, SCENARIO_MAGIC, sizeof(SCENARIO_MAGIC));
+  header.version = SCENARIO_VERSION;
+  header.record_size = sizeof(scenario_record);
+  fwrite(&header, sizeof(header), 1, out);
+
+  ai = aircraft_alloc();
+  while (scenario_next(&scenario, ai))
+  {
+    rec.aircraft_type = ai->aircraft_type;
+    rec.arrival_time = ai->arrival_time;
+    rec.runway_time = ai->runway_time;
+    rec.fuel_reserve = scenario.fuel_fixed ? ai->fuel_reserve : SCENARIO_RANDOM_FUEL;
+    fwrite(&rec, sizeof(rec), 1, out);
+    header.count++;
+  }
+  aircraft_release(ai);
+  scenario_close(&scenario);
+
+  /* the count is only known now */
+  rewind(out);
+  fwrite(&header, sizeof(header), 1, out);
+  failed = ferror(out);
+  if (fclose(out) != 0 || failed)
+  {
+    printf("Cannot write output file %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  printf("Wrote %lld aircraft to %s\n", header.count, path);
+  return 0;
+}
+
+/*
+ * Function: schedule_load
+ * Parameters: path - schedule written by --record
+ * Returns: 0 on success, 1 after printing why the file cannot be used
+ * Description: Map the schedule for --replay and take over the seed,
+ * runways, parameters and policy it was recorded with.  Each runway's
+ * decisions are found through replay_offsets and each aircraft's runway
+ * through replay_route.
+ */
+static int schedule_load(char *path)
+{
+  const schedule_header *header;
+  const schedule_record *d;
+  struct stat st;
+  long long i;
+  int fd;
+  int k;
+
+  if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+  {
+    printf("Cannot open schedule file %s for reading.\n", path);
+    return 1;
+  }
+  replay_size = st.st_size;
+  if (replay_size < sizeof(*header)
+      || (replay_map = mmap(NULL, replay_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    printf("Cannot map schedule file %s.\n", path);
+    close(fd);
+    replay_map = NULL;
+    return 1;
+  }
+  close(fd);
+
+  header = (const schedule_header *)replay_map;
+  if (memcmp(header->magic, SCHEDULE_MAGIC, sizeof(SCHEDULE_MAGIC)) != 0
+      || header->version != SCHEDULE_VERSION || header->record_size != sizeof(schedule_record)
+      || header->count < 0 || header->aircraft <= 0 || header->aircraft > INT_MAX
+      || (replay_size - sizeof(*header)) / sizeof(schedule_record) != (size_t)header->count
+      || header->runway_count <= 0 || header->params > CONFIG_PARAMS)
+  {
+    printf("Schedule file %s was not recorded by this version of runway on this machine.\n",
+           path);
+    return 1;
+  }
+
+  fuel_seed = header->seed;
+  runway_count = header->runway_count;
+  /* parameters added since the recording keep their defaults */
+  for (k = 0; k < header->params; k++)
+  {
+    if (config_check_value(k, header->param_values[k]) != 0)
+      return 1;
+    *config_params[k].value = header->param_values[k];
+  }
+  for (k = 0; k < POLICIES && strncmp(policies[k].name, header->policy, sizeof(header->policy)) != 0; k++)
+    ;
+  if (k == POLICIES)
+  {
+    printf("Schedule file %s uses an unknown policy.\n", path);
+    return 1;
   }
+  policy = &policies[k];
 
-  pthread_mutex_lock(&Mutex_COM);
+  replay_records = (const schedule_record *)(header + 1);
+  replay_aircraft_count = header->aircraft;
+  replay_offsets = calloc(runway_count + 1, sizeof(*replay_offsets));
+  replay_route = malloc(header->aircraft * sizeof(*replay_route));
+  replay_aircraft = calloc(header->aircraft, sizeof(*replay_aircraft));
+  if (replay_offsets == NULL || replay_route == NULL || replay_aircraft == NULL)
+  {
+    printf("runway: out of memory loading the schedule\n");
+    exit(1);
+  }
+  for (i = 0; i < header->aircraft; i++)
+    replay_route[i] = -1;
 
-  while(!ready_COM)
+  /* the records come runway by runway */
+  k = 0;
+  for (i = 0; i < header->count; i++)
   {
-    pthread_cond_wait(&Cond_COM, &Mutex_COM);
-  } 
-  aircraft_on_runway    = aircraft_on_runway + 1;
-  aircraft_since_break  = aircraft_since_break + 1;
-  commercial_on_runway  = commercial_on_runway + 1;
-  consecutive_direction = consecutive_direction + 1;
-  ready_COM = 0;
-  Commercial_Waiting--;
-  pthread_mutex_unlock(&Mutex_COM);
+    d = &replay_records[i];
+    if (d->runway < k || d->runway >= runway_count || d->decision < SCHED_QUEUE
+        || d->decision > SCHED_SWITCH_BREAK || d->aircraft_id < -1
+        || d->aircraft_id >= header->aircraft
+        || (d->aircraft_id < 0 && d->decision <= SCHED_GRANT))
+    {
+      printf("Schedule file %s is damaged at record %lld.\n", path, i);
+      return 1;
+    }
+    while (k < d->runway)
+      replay_offsets[++k] = i;
+    if (d->decision == SCHED_QUEUE)
+      replay_route[d->aircraft_id] = d->runway;
+  }
+  while (k < runway_count)
+    replay_offsets[++k] = header->count;
+  return 0;
 }
 
-/* Code executed by a cargo aircraft to enter the runway.
- * You have to implement this.  Do not delete the assert() statements,
- * but feel free to add your own.
- * Function: cargo_enter
- * Parameters: aircraft_info _ pointer to aircraft information structure.
- * Returns: void
- * Description: This function handles the way cargo enters the runway. The
- *              aircraft stays in a loop to simulate it running out of fuel
- *              ,when it runs out it makes an emergency warning and tries
- *              to get priority. To get on the runway, it must be signaled
- *              from the controller thread to continue on.
+/* Write the decisions of the run just played to path for --record.
+ * Returns 0 on success or 1.
  */
-void cargo_enter(aircraft_info *ai) 
+static int schedule_write(char *path)
 {
-  (void)ai;
-
-  /* TODO */
-  /* Request permission to use the runway. You might also want to add      */
-  /* synchronization for the simulation variables below.                   */
-  /* Consider: runway capacity, direction (cargo prefer SOUTH),            */
-  /* controller breaks, fuel levels, emergency priorities, and fairness.   */
-  /*  YOUR CODE HERE.                                                      */ 
-  pthread_mutex_lock(&Mutex_ENTER);
-
-  Cargo_Waiting++;
+  schedule_header header;
+  FILE *out;
+  int failed;
+  int i;
 
-  pthread_mutex_unlock(&Mutex_ENTER);
+  if ((out = fopen(path, "wb")) == NULL)
+  {
+    printf("Cannot open schedule file %s for writing.\n", path);
+    return 1;
+  }
 
-  while(1)
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCHEDULE_MAGIC, sizeof(SCHEDULE_MAGIC));
+  header.version = SCHEDULE_VERSION;
+  header.record_size = sizeof(schedule_record);
+  header.seed = fuel_seed;
+  header.runway_count = runway_count;
+  header.params = CONFIG_PARAMS;
+  for (i = 0; i < CONFIG_PARAMS; i++)
+    header.param_values[i] = *config_params[i].value;
+  strncpy(header.policy, policy->name, sizeof(header.policy) - 1);
+  header.aircraft = aircraft_done;
+  fwrite(&header, sizeof(header), 1, out);
+  for (i = 0; i < runway_count; i++)
   {
-    pthread_mutex_lock(&Mutex_WAITCAR);
-    Fuel_CAR = (int)time(NULL) - (int)ai->arrival_timestamp;
-    if(Fuel_CAR >= ai->fuel_reserve)
-    {
-      printf("EMERGENCY: Cargo Aircraft %d has ran out of reserved fuel and will land imminently!\n"
-        , ai->aircraft_id);
-      Cargo_Waiting--;
-      Fuel_Waiting_CAR++;
-      pthread_mutex_unlock(&Mutex_WAITCAR);
-      pthread_mutex_lock(&Mutex_FUEL_CAR);
-      while(!ready_FUEL_CAR)
-      {
-        pthread_cond_wait(&Cond_FUEL_CAR, &Mutex_FUEL_CAR);
-      }
-      aircraft_on_runway    = aircraft_on_runway + 1;
-      aircraft_since_break  = aircraft_since_break + 1;
-      cargo_on_runway       = cargo_on_runway + 1;
-      consecutive_direction = consecutive_direction + 1;
-      ready_FUEL_CAR = 0;
-      Priority_CAR = 0;
-      Fuel_Waiting_CAR--;
-      pthread_mutex_unlock(&Mutex_FUEL_CAR);
-      return;
-    }
-    if(Signal_CAR == 1)
-    {
-      Signal_CAR = 0;
-      pthread_mutex_unlock(&Mutex_WAITCAR);
-      break;
-    }
-    pthread_mutex_unlock(&Mutex_WAITCAR);
-    sleep(1);
+    fwrite(runways[i].decisions, sizeof(schedule_record), runways[i].decision_count, out);
+    header.count += runways[i].decision_count;
   }
 
-  pthread_mutex_lock(&Mutex_CAR);
+  /* the count is only known now */
+  rewind(out);
+  fwrite(&header, sizeof(header), 1, out);
 
-  while(!ready_CAR)
+  failed = ferror(out);
+  if (fclose(out) != 0 || failed)
   {
-    pthread_cond_wait(&Cond_CAR, &Mutex_CAR);
+    printf("Cannot write schedule file %s: %s\n", path, strerror(errno));
+    return 1;
   }
-  aircraft_on_runway    = aircraft_on_runway + 1;
-  aircraft_since_break  = aircraft_since_break + 1;
-  cargo_on_runway       = cargo_on_runway + 1;
-  consecutive_direction = consecutive_direction + 1;
-  ready_CAR = 0;
-  Cargo_Waiting--;
-  pthread_mutex_unlock(&Mutex_CAR);
+  printf("Recorded %lld decisions to %s (seed %llu)\n", header.count, path, fuel_seed);
+  return 0;
 }
 
-/* Code executed by an emergency aircraft to enter the runway.
- * You have to implement this.  Do not delete the assert() statements,
- * but feel free to add your own.
- * Function: emergency_enter
- * Parameters:aircraft_info - pointer to aircraft information structure
- * Returns: void
- * Description: This functions controls the entrance of the incoming emergency
- *              aircraft. The aircraft waits here until the controller signals
- *              it to get on the runway and it's safe to use.
- */
-void emergency_enter(aircraft_info *ai) 
+/* How closely --replay followed the schedule. */
+static void print_replay_summary()
 {
-  (void)ai;
-
-  /* TODO */
-  /* Request permission to use the runway. You might also want to add      */
-  /* synchronization for the simulation variables below.                   */
-  /* Emergency aircraft have priority and must be admitted within 30s,     */
-  /* but still respect runway capacity and controller breaks.              */
-  /* Emergency aircraft can use either direction.                          */
-  /*  YOUR CODE HERE.                                                      */ 
+  long decisions = 0, late = 0, left = 0;
 
-  pthread_mutex_lock(&Mutex_EMER);
-
-  Emergency_Waiting++;
+  long k;
+  int i;
 
-  while(!ready_EMER)
+  /* a break the controller took as the last aircraft left may or may not
+   * have made it into the recording before the shutdown
+   */
+  for (i = 0; i < runway_count; i++)
   {
-    pthread_cond_wait(&Cond_EMER, &Mutex_EMER);
+    decisions += runways[i].replay_next - replay_offsets[i];
+    for (k = runways[i].replay_next; k < runways[i].replay_end; k++)
+      left += replay_records[k].time < makespan;
+    late += runways[i].replay_late;
   }
-  aircraft_on_runway = aircraft_on_runway + 1;
-  aircraft_since_break = aircraft_since_break + 1;
-  emergency_on_runway = emergency_on_runway + 1;
-  consecutive_direction = consecutive_direction + 1;
-  ready_EMER = 0;
-  Emergency_Waiting--;
-  pthread_mutex_unlock(&Mutex_EMER);
+  printf("Replayed %ld records of %s (seed %llu), %ld decisions later than recorded",
+         decisions, schedule_path, fuel_seed, late);
+  if (left > 0)
+    printf(", %ld not reached", left);
+  printf("\n");
 }
 
-/* Code executed by an aircraft to simulate the time spent on the runway
- * You do not need to add anything here.  
- */
-static void use_runway(int t) 
+/* Unmap the --replay schedule. */
+static void schedule_close()
 {
-  sleep(t);
+  free(replay_offsets);
+  free(replay_route);
+  free(replay_aircraft);
+  if (replay_map != NULL)
+    munmap(replay_map, replay_size);
 }
 
+#ifdef LOCK_PROFILE
+/*** Lock profile ***/
 
-/* Code executed by a commercial aircraft when leaving the runway.
- * You need to implement this.  Do not delete the assert() statements,
- * but feel free to add as many of your own as you like.
- * Function:commercial_leave
- * Parameters: none
- * Returns: void
- * Description: Handles when a aircraft leaves. Just a simple
- *              mutex use and decrement of variables to get
- *              out of the runway.
+/* Counters of one named primitive, or of all runways' instances of one
+ * runway_info field.  Times are wall-clock ns.
  */
-static void commercial_leave() 
+typedef struct
 {
-  /* 
-   *  TODO
-   *  YOUR CODE HERE. 
-   */
-  pthread_mutex_lock(&Mutex_COML);
-  aircraft_on_runway = aircraft_on_runway - 1;
-  commercial_on_runway = commercial_on_runway - 1;
-  pthread_mutex_unlock(&Mutex_COML);
-}
+  const char *name;
+  int kind;                 /* PROFILE_MUTEX, PROFILE_COND or PROFILE_SIM_COND */
+  const void *addr;         /* the primitive, NULL for a runway field or the catch-all */
+  long field;               /* offset in runway_info, -1 if not a runway field */
+  long acquisitions;
+  long contended;           /* had to wait for the mutex, or a trylock failed */
+  long long wait_total;
+  long long wait_max;
+  long long hold_total;
+  long long hold_max;
+  long waits;               /* on a condition variable */
+  long wakeups;             /* waits that were signalled */
+  long timeouts;
+  long rewaits;             /* wake-ups after which the thread waited again
+                               without letting go of the mutex: its predicate
+                               did not hold yet, whether the wake-up was
+                               spurious or a signal for progress short of it */
+} lock_profile;
 
-/* Code executed by a cargo aircraft when leaving the runway.
- * You need to implement this.  Do not delete the assert() statements,
- * but feel free to add as many of your own as you like.
- * Function: cargo_leave
- * Parameters: none
- * Returns: void
- * Description: a simple leave function for the cargo aircraft.
- *              Uses a mutex to protect critical region to 
- *              decrement the variables to leave the runway.
+/* The primitive without a name of its own of each kind catches the rest:
+ * the clock's per-waiter conditions and the aircraft's grant conditions.
  */
-static void cargo_leave() 
+static lock_profile lock_profiles[] =
 {
-  /* 
-   * TODO
-   * YOUR CODE HERE. 
-   */
-  pthread_mutex_lock(&Mutex_CARL);
-  aircraft_on_runway = aircraft_on_runway - 1;
-  cargo_on_runway = cargo_on_runway - 1;
-  pthread_mutex_unlock(&Mutex_CARL);
-}
+  { "Mutex_CLOCK",     PROFILE_MUTEX, &Mutex_CLOCK,     -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_DONE",      PROFILE_MUTEX, &Mutex_DONE,      -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_FORECAST",  PROFILE_MUTEX, &Mutex_FORECAST,  -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_BACKLOG",   PROFILE_MUTEX, &Mutex_BACKLOG,   -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_ARENA",     PROFILE_MUTEX, &Mutex_ARENA,     -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_LOG",       PROFILE_MUTEX, &Mutex_LOG,       -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Mutex_WATCHDOG",  PROFILE_MUTEX, &Mutex_WATCHDOG,  -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "runway.mutex",    PROFILE_MUTEX, NULL, offsetof(runway_info, mutex), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "runway.controller_mutex", PROFILE_MUTEX, NULL, offsetof(runway_info, controller_mutex),
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "other mutexes",   PROFILE_MUTEX, NULL,             -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_LOG",        PROFILE_COND,  &Cond_LOG,        -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_LOG_FLUSHED", PROFILE_COND, &Cond_LOG_FLUSHED, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_LOG_SPACE",  PROFILE_COND,  &Cond_LOG_SPACE,  -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_WATCHDOG",   PROFILE_COND,  &Cond_WATCHDOG,   -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "timer_thread_cond", PROFILE_COND, &timer_thread_cond, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "sim_waiter.cond", PROFILE_COND,  NULL,             -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_DONE",       PROFILE_SIM_COND, &Cond_DONE,    -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_BACKLOG",    PROFILE_SIM_COND, &Cond_BACKLOG, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "Cond_WATCHDOG_TIMER", PROFILE_SIM_COND, &Cond_WATCHDOG_TIMER, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "runway.controller_cond", PROFILE_SIM_COND, NULL, offsetof(runway_info, controller_cond),
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { "aircraft.grant",  PROFILE_SIM_COND, NULL,          -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
 
-/* Code executed by an emergency aircraft when leaving the runway.
- * You need to implement this.  Do not delete the assert() statements,
- * but feel free to add as many of your own as you like.
- * Function: emergency_leave
- * Parameters: none
- * Returns: void
- * Description: a simple leave function for the emergency aircraft.
- *              Uses a mutex to protect critical region to 
- *              decrement the variables to leave the runway.
+#define PROFILES (int)(sizeof(lock_profiles) / sizeof(lock_profiles[0]))
+#define PROFILE_HELD 8           /* mutexes one thread holds at once, at most */
+
+/* Mutexes the thread holds and since when, for the hold times, and the
+ * condition it was last woken on while it still holds that mutex.
  */
-static void emergency_leave() 
+static __thread const void *profile_held[PROFILE_HELD];
+static __thread long long profile_held_since[PROFILE_HELD];
+static __thread int profile_held_count = 0;
+static __thread const void *profile_woken = NULL;
+static __thread const void *profile_woken_mutex = NULL;
+static pid_t profile_pid;
+
+static long long profile_clock()
 {
-  /* 
-   * TODO
-   * YOUR CODE HERE. 
-   */
-  pthread_mutex_lock(&Mutex_EMERL);
-  aircraft_on_runway = aircraft_on_runway - 1;
-  emergency_on_runway = emergency_on_runway - 1;
-  pthread_mutex_unlock(&Mutex_EMERL);
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
 }
 
-/* Main code for commercial aircraft threads.  
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
- */
-void* commercial_aircraft(void *ai_ptr) 
+static lock_profile *profile_find(const void *p, int kind)
 {
-  aircraft_info *ai = (aircraft_info*)ai_ptr;
-  
-  /* Record arrival time for fuel tracking */
-  ai->arrival_timestamp = time(NULL);
-
-  /* Request runway access */
-  commercial_enter(ai);
+  lock_profile *other = NULL;
+  const char *base = (const char *)runways;
+  int i;
 
-  printf("Commercial aircraft %d (fuel: %ds) is now on the runway (direction: %s)\n", 
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
+  for (i = 0; i < PROFILES; i++)
+  {
+    lock_profile *lp = &lock_profiles[i];
 
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway == 0 ); // Commercial and cargo cannot mix
-  
-  /* Use runway  --- do not make changes to the 3 lines below*/
-  printf("Commercial aircraft %d begins runway operations for %d seconds\n", 
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("Commercial aircraft %d completes runway operations and prepares to depart\n", 
-         ai->aircraft_id);
+    if (lp->kind != kind)
+      continue;
+    if (lp->addr == p)
+      return lp;
+    if (lp->field >= 0 && base != NULL && (const char *)p >= base
+        && (const char *)p < base + runway_count * sizeof(runway_info)
+        && ((const char *)p - base) % sizeof(runway_info) == (size_t)lp->field)
+      return lp;
+    if (lp->addr == NULL && lp->field < 0)
+      other = lp;
+  }
+  return other;
+}
 
-  /* Leave runway */
-  commercial_leave();  
+static void profile_max(long long *max, long long v)
+{
+  long long old = __atomic_load_n(max, __ATOMIC_RELAXED);
 
-  printf("Commercial aircraft %d has cleared the runway\n", ai->aircraft_id);
+  while (v > old && !__atomic_compare_exchange_n(max, &old, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0)) {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+static void profile_hold_begin(const void *m, long long now)
+{
+  if (profile_held_count < PROFILE_HELD)
+  {
+    profile_held[profile_held_count] = m;
+    profile_held_since[profile_held_count++] = now;
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+}
 
-  pthread_exit(NULL);
+static void profile_hold_end(lock_profile *lp, const void *m)
+{
+  long long hold;
+  int i;
+
+  for (i = profile_held_count - 1; i >= 0 && profile_held[i] != m; i--)
+    ;
+  if (i < 0)
+    return;
+  hold = profile_clock() - profile_held_since[i];
+  __atomic_fetch_add(&lp->hold_total, hold, __ATOMIC_RELAXED);
+  profile_max(&lp->hold_max, hold);
+  for (profile_held_count--; i < profile_held_count; i++)
+  {
+    profile_held[i] = profile_held[i + 1];
+    profile_held_since[i] = profile_held_since[i + 1];
+  }
 }
 
-/* Main code for cargo aircraft threads.
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
- */
-void* cargo_aircraft(void *ai_ptr) 
+static int profile_mutex_lock(pthread_mutex_t *m)
 {
-  aircraft_info *ai = (aircraft_info*)ai_ptr;
-  
-  /* Record arrival time for fuel tracking */
-  ai->arrival_timestamp = time(NULL);
+  lock_profile *lp = profile_find(m, PROFILE_MUTEX);
+  long long start, now;
+  int result = (pthread_mutex_trylock)(m);
 
-  /* Request runway access */
-  cargo_enter(ai);
+  if (result == EBUSY)
+  {
+    start = profile_clock();
+    result = (pthread_mutex_lock)(m);
+    now = profile_clock();
+    __atomic_fetch_add(&lp->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&lp->wait_total, now - start, __ATOMIC_RELAXED);
+    profile_max(&lp->wait_max, now - start);
+  }
+  else
+  {
+    now = profile_clock();
+  }
+  if (result == 0)
+  {
+    __atomic_fetch_add(&lp->acquisitions, 1, __ATOMIC_RELAXED);
+    profile_hold_begin(m, now);
+  }
+  return result;
+}
 
-  printf("Cargo aircraft %d (fuel: %ds) is now on the runway (direction: %s)\n", 
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
+static int profile_mutex_trylock(pthread_mutex_t *m)
+{
+  lock_profile *lp = profile_find(m, PROFILE_MUTEX);
+  int result = (pthread_mutex_trylock)(m);
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0)) {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", aircraft_on_runway, 
-            MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+  if (result == 0)
+  {
+    __atomic_fetch_add(&lp->acquisitions, 1, __ATOMIC_RELAXED);
+    profile_hold_begin(m, profile_clock());
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(commercial_on_runway == 0 ); 
+  else
+  {
+    __atomic_fetch_add(&lp->contended, 1, __ATOMIC_RELAXED);
+  }
+  return result;
+}
+
+static int profile_mutex_unlock(pthread_mutex_t *m)
+{
+  profile_hold_end(profile_find(m, PROFILE_MUTEX), m);
+  if (profile_woken_mutex == m)
+    profile_woken = profile_woken_mutex = NULL;
+  return (pthread_mutex_unlock)(m);
+}
 
-  printf("Cargo aircraft %d begins runway operations for %d seconds\n", 
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("Cargo aircraft %d completes runway operations and prepares to depart\n", 
-         ai->aircraft_id);
+/* A wait on condition c of the given kind starts; m is held. */
+static void profile_wait_begin(const void *c, pthread_mutex_t *m, int kind)
+{
+  lock_profile *lp = profile_find(c, kind);
 
-  /* Leave runway */
-  cargo_leave();        
+  __atomic_fetch_add(&lp->waits, 1, __ATOMIC_RELAXED);
+  if (profile_woken == c && profile_woken_mutex == m)
+    __atomic_fetch_add(&lp->rewaits, 1, __ATOMIC_RELAXED);
+  profile_woken = profile_woken_mutex = NULL;
+}
 
-  printf("Cargo aircraft %d has cleared the runway\n", ai->aircraft_id);
+/* The wait on c has returned and m is held again. */
+static void profile_wait_end(const void *c, pthread_mutex_t *m, int kind, int timed_out)
+{
+  lock_profile *lp = profile_find(c, kind);
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0)) {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", 
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+  if (timed_out)
+  {
+    __atomic_fetch_add(&lp->timeouts, 1, __ATOMIC_RELAXED);
+    return;
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+  __atomic_fetch_add(&lp->wakeups, 1, __ATOMIC_RELAXED);
+  profile_woken = c;
+  profile_woken_mutex = m;
+}
 
-  pthread_exit(NULL);
+static int profile_cond_wait(pthread_cond_t *c, pthread_mutex_t *m)
+{
+  lock_profile *lp = profile_find(m, PROFILE_MUTEX);
+  int result;
+
+  profile_wait_begin(c, m, PROFILE_COND);
+  profile_hold_end(lp, m);
+  result = (pthread_cond_wait)(c, m);
+  profile_hold_begin(m, profile_clock());
+  profile_wait_end(c, m, PROFILE_COND, 0);
+  return result;
 }
 
-/* Main code for emergency aircraft threads.
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
- */
-void* emergency_aircraft(void *ai_ptr) 
+static int profile_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m, const struct timespec *t)
 {
-  aircraft_info *ai = (aircraft_info*)ai_ptr;
-  
-  /* Record arrival time for fuel and emergency timeout tracking */
-  ai->arrival_timestamp = time(NULL);
+  lock_profile *lp = profile_find(m, PROFILE_MUTEX);
+  int result;
+
+  profile_wait_begin(c, m, PROFILE_COND);
+  profile_hold_end(lp, m);
+  result = (pthread_cond_timedwait)(c, m, t);
+  profile_hold_begin(m, profile_clock());
+  profile_wait_end(c, m, PROFILE_COND, result == ETIMEDOUT);
+  return result;
+}
 
-  /* Request runway access */
-  emergency_enter(ai);
+static int profile_compare_mutex(const void *a, const void *b)
+{
+  const lock_profile *x = *(lock_profile * const *)a, *y = *(lock_profile * const *)b;
 
-  printf("EMERGENCY aircraft %d (fuel: %ds) is now on the runway (direction: %s)\n", 
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
+  if (x->contended != y->contended)
+    return x->contended < y->contended ? 1 : -1;
+  return (x->wait_total < y->wait_total) - (x->wait_total > y->wait_total);
+}
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0)) {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", aircraft_on_runway, 
-            MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
-  }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+static int profile_compare_cond(const void *a, const void *b)
+{
+  const lock_profile *x = *(lock_profile * const *)a, *y = *(lock_profile * const *)b;
 
-  printf("EMERGENCY aircraft %d begins runway operations for %d seconds\n", 
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("EMERGENCY aircraft %d completes runway operations and prepares to depart\n", 
-         ai->aircraft_id);
+  if (x->rewaits != y->rewaits)
+    return x->rewaits < y->rewaits ? 1 : -1;
+  return (x->waits < y->waits) - (x->waits > y->waits);
+}
 
-  /* Leave runway */
-  emergency_leave();        
+/* Print the mutexes ranked by contended acquisitions, then the condition
+ * variables ranked by wake-ups that were followed by another wait.  Registered with atexit(), and
+ * only printed by the process that started, not by replicas.
+ */
+static void profile_report()
+{
+  lock_profile *sorted[PROFILES];
+  int n = 0;
+  int i;
 
-  printf("EMERGENCY aircraft %d has cleared the runway\n", ai->aircraft_id);
+  if (getpid() != profile_pid)
+    return;
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0)) {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n", 
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, direction=%s\n", 
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+  for (i = 0; i < PROFILES; i++)
+    if (lock_profiles[i].kind == PROFILE_MUTEX && lock_profiles[i].acquisitions + lock_profiles[i].contended > 0)
+      sorted[n++] = &lock_profiles[i];
+  qsort(sorted, n, sizeof(sorted[0]), profile_compare_mutex);
+  printf("\n=== Lock contention profile ===\n");
+  printf("%-24s %12s %12s %7s %12s %10s %12s %10s\n", "mutex", "acquired", "contended", "(%)",
+         "wait ms", "max wait", "hold ms", "max hold");
+  for (i = 0; i < n; i++)
+  {
+    lock_profile *lp = sorted[i];
+
+    printf("%-24s %12ld %12ld %6.2f%% %12.3f %10.3f %12.3f %10.3f\n", lp->name, lp->acquisitions,
+           lp->contended, lp->acquisitions ? 100.0 * lp->contended / lp->acquisitions : 0.0,
+           lp->wait_total / 1e6, lp->wait_max / 1e6, lp->hold_total / 1e6, lp->hold_max / 1e6);
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY && aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 && commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 && cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 && emergency_on_runway <= MAX_RUNWAY_CAPACITY);
 
-  pthread_exit(NULL);
+  n = 0;
+  for (i = 0; i < PROFILES; i++)
+    if (lock_profiles[i].kind != PROFILE_MUTEX && lock_profiles[i].waits > 0)
+      sorted[n++] = &lock_profiles[i];
+  qsort(sorted, n, sizeof(sorted[0]), profile_compare_cond);
+  printf("\n%-24s %12s %12s %12s %12s\n", "condition", "waits", "wakeups", "timeouts", "rewaits");
+  for (i = 0; i < n; i++)
+  {
+    lock_profile *lp = sorted[i];
+
+    printf("%-24s %12ld %12ld %12ld %12ld\n", lp->name, lp->waits, lp->wakeups, lp->timeouts,
+           lp->rewaits);
+  }
+  fflush(stdout);
+}
+
+static void profile_start()
+{
+  profile_pid = getpid();
+  atexit(profile_report);
 }
+#endif
 
 /* Main function sets up simulation and prints report
  * at the end.
@@ -829,78 +6616,243 @@ void* emergency_aircraft(void *ai_ptr)
  */
 int main(int nargs, char **args) 
 {
+  int opt;
+  int use_virtual_time = 0;
+  int workers = 0;
+  int trials = 0;
+  char *scenario_path = NULL;
+  char *end;
+  int compare = 0;
+  int failed = 0;
   int i;
-  int result;
-  int num_aircraft;
-  void *status;
-  pthread_t controller_tid;
-  pthread_t aircraft_tid[MAX_AIRCRAFT];
-  aircraft_info ai[MAX_AIRCRAFT];
+  static const struct option long_options[] =
+  {
+    { "virtual-time", no_argument, NULL, 'v' },
+    { "stats",        no_argument, NULL, 's' },
+    { "pool",         optional_argument, NULL, 'p' },
+    { "runways",      required_argument, NULL, 'r' },
+    { "trials",       required_argument, NULL, 't' },
+    { "seed",         required_argument, NULL, 'S' },
+    { "binary-log",   required_argument, NULL, 'b' },
+    { "generate",     optional_argument, NULL, 'g' },
+    { "write-scenario", required_argument, NULL, 'w' },
+    { "set",          required_argument, NULL, 'c' },
+    { "sweep",        required_argument, NULL, 'W' },
+    { "policy",       required_argument, NULL, 'P' },
+    { "compare-policies", no_argument,   NULL, 'C' },
+    { "record",       required_argument, NULL, 'R' },
+    { "replay",       required_argument, NULL, 'y' },
+    { "live-stats",   optional_argument, NULL, 'L' },
+    { "watchdog",     optional_argument, NULL, 'd' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  fuel_seed = (unsigned long long)time(NULL);
+  profile_start();
+
+  while ((opt = getopt_long(nargs, args, "", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'v':
+        use_virtual_time = 1;
+        break;
+      case 's':
+        print_stats = 1;
+        break;
+      case 'p':
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if ((optarg && parse_positive(optarg, &workers) != 0) || workers <= 0)
+        {
+          printf("runway: --pool needs a positive number of workers\n");
+          return EINVAL;
+        }
+        break;
+      case 'r':
+        if (parse_positive(optarg, &runway_count) != 0)
+        {
+          printf("runway: --runways needs a positive number of runways\n");
+          return EINVAL;
+        }
+        break;
+      case 't':
+        if (parse_positive(optarg, &trials) != 0)
+        {
+          printf("runway: --trials needs a positive number of trials\n");
+          return EINVAL;
+        }
+        break;
+      case 'S':
+        errno = 0;
+        fuel_seed = strtoull(optarg, &end, 0);
+        if (end == optarg || *end != '\0' || errno != 0 || optarg[0] == '-')
+        {
+          printf("runway: --seed needs a non-negative number\n");
+          return EINVAL;
+        }
+        break;
+      case 'b':
+        log_mode = LOG_BINARY;
+        log_binary_path = optarg;
+        break;
+      case 'g':
+        generate = 1;
+        if (optarg && parse_workload(optarg) != 0)
+          return EINVAL;
+        break;
+      case 'w':
+        scenario_path = optarg;
+        break;
+      case 'c':
+        if (config_set(optarg) != 0)
+          return EINVAL;
+        break;
+      case 'W':
+        if (sweep_add(optarg) != 0)
+          return EINVAL;
+        break;
+      case 'P':
+        for (i = 0; i < POLICIES && strcmp(policies[i].name, optarg) != 0; i++)
+          ;
+        if (i == POLICIES)
+        {
+          printf("runway: unknown policy %s, known are:", optarg);
+          for (i = 0; i < POLICIES; i++)
+            printf(" %s", policies[i].name);
+          printf("\n");
+          return EINVAL;
+        }
+        policy = &policies[i];
+        break;
+      case 'C':
+        compare = 1;
+        break;
+      case 'R':
+      case 'y':
+        if (schedule_mode != SCHEDULE_OFF)
+        {
+          printf("runway: --record and --replay can only be given once between them\n");
+          return EINVAL;
+        }
+        schedule_mode = opt == 'R' ? SCHEDULE_RECORD : SCHEDULE_REPLAY;
+        schedule_path = optarg;
+        break;
+      case 'L':
+        live_name = optarg ? optarg : LIVE_DEFAULT_NAME;
+        if (live_name[0] != '/' || strchr(live_name + 1, '/') != NULL || live_name[1] == '\0')
+        {
+          printf("runway: --live-stats needs a name like %s\n", LIVE_DEFAULT_NAME);
+          return EINVAL;
+        }
+        break;
+      case 'd':
+        watchdog_seconds = WATCHDOG_DEFAULT;
+        if (optarg && parse_positive(optarg, &watchdog_seconds) != 0)
+        {
+          printf("runway: --watchdog needs a positive number of seconds\n");
+          return EINVAL;
+        }
+        break;
+      default:
+        printf("Usage: runway [--virtual-time] [--stats] [--pool[=N]] [--runways=N]\n"
+               "              [--trials=N] [--seed=N] [--binary-log=FILE] [--write-scenario=FILE]\n"
+               "              [--set=NAME=VALUE]... [--sweep=NAME=VALUES]...\n"
+               "              [--policy=NAME] [--compare-policies]\n"
+               "              [--record=FILE | --replay=FILE] [--live-stats[=NAME]]\n"
+               "              [--watchdog[=SECONDS]]\n"
+               "              <name of inputfile> | --generate=SPEC\n");
+        return EINVAL;
+    }
+  }
 
-  if (nargs != 2) 
+  if (nargs - optind != (generate ? 0 : 1)) 
   {
-    printf("Usage: runway <name of inputfile>\n");
+    printf("Usage: runway [--virtual-time] [--stats] [--pool[=N]] [--runways=N]\n"
+           "              [--trials=N] [--seed=N] [--binary-log=FILE] [--write-scenario=FILE]\n"
+           "              [--set=NAME=VALUE]... [--sweep=NAME=VALUES]...\n"
+           "              [--policy=NAME] [--compare-policies]\n"
+           "              [--record=FILE | --replay=FILE] [--live-stats[=NAME]]\n"
+           "              [--watchdog[=SECONDS]]\n"
+           "              <name of inputfile> | --generate=SPEC\n");
     return EINVAL;
   }
 
-  num_aircraft = initialize(ai, args[1]);
-  if (num_aircraft > MAX_AIRCRAFT || num_aircraft <= 0) 
+  /* the schedule's settings replace those on the command line */
+  if (schedule_mode == SCHEDULE_REPLAY && schedule_load(schedule_path) != 0)
   {
-    printf("Error:  Bad number of aircraft threads. "
-           "Maybe there was a problem with your input file?\n");
-    return 1;
+    schedule_close();
+    return EINVAL;
+  }
+
+  if (config_check() != 0)
+  {
+    return EINVAL;
   }
 
-  printf("Starting runway simulation with %d aircraft ...\n", num_aircraft);
+  if (scenario_path != NULL)
+  {
+    failed = write_scenario(generate ? NULL : args[optind], scenario_path);
+    runways_destroy();
+    aircraft_arena_destroy();
+    return failed;
+  }
 
-  result = pthread_create(&controller_tid, NULL, controller_thread, NULL);
+  /* --trials with --sweep or --compare-policies sets the trials per cell */
+  if ((sweep_count > 0) + compare + (schedule_mode != SCHEDULE_OFF) > 1
+      || (trials > 0 && schedule_mode != SCHEDULE_OFF))
+  {
+    printf("runway: --sweep, --trials, --compare-policies and --record/--replay "
+           "cannot be combined, except --trials with --sweep or --compare-policies\n");
+    return EINVAL;
+  }
 
-  if (result) 
+  if ((sweep_count > 0 || trials > 0 || compare) && !generate && scenario_is_stream(args[optind]))
   {
-    printf("runway:  pthread_create failed for controller: %s\n", strerror(result));
-    exit(1);
+    printf("runway: --sweep, --trials and --compare-policies play the scenario more than once, "
+           "%s is a stream\n", args[optind]);
+    return EINVAL;
   }
 
-  for (i=0; i < num_aircraft; i++) 
+  if (live_name != NULL && (sweep_count > 0 || trials > 0 || compare))
   {
-    ai[i].aircraft_id = i;
-    sleep(ai[i].arrival_time);
-                
-    if (ai[i].aircraft_type == COMMERCIAL)
-    {
-      result = pthread_create(&aircraft_tid[i], NULL, commercial_aircraft, 
-                             (void *)&ai[i]);
-    }
-    else if (ai[i].aircraft_type == CARGO)
-    {
-      result = pthread_create(&aircraft_tid[i], NULL, cargo_aircraft, 
-                             (void *)&ai[i]);
-    }
-    else 
-    {
-      result = pthread_create(&aircraft_tid[i], NULL, emergency_aircraft, 
-                             (void *)&ai[i]);
-    }
+    printf("runway: --live-stats shows a single run, not --sweep, --trials or --compare-policies\n");
+    return EINVAL;
+  }
 
-    if (result) 
-    {
-      printf("runway: pthread_create failed for aircraft %d: %s\n", 
-            i, strerror(result));
-      exit(1);
-    }
+  if (compare)
+  {
+    return run_comparison(generate ? NULL : args[optind], trials ? trials : CELL_TRIALS, workers);
   }
 
-  /* wait for all aircraft threads to finish */
-  for (i = 0; i < num_aircraft; i++) 
+  if (sweep_count > 0)
   {
-    pthread_join(aircraft_tid[i], &status);
+    return run_sweep(generate ? NULL : args[optind], trials ? trials : CELL_TRIALS, workers);
   }
 
-  /* tell the controller to finish. */
-  pthread_cancel(controller_tid);
-  pthread_join(controller_tid, &status);
+  if (trials > 0)
+  {
+    return run_trials(generate ? NULL : args[optind], trials, workers);
+  }
 
-  printf("Runway simulation done.\n");
+  run_simulation(generate ? NULL : args[optind], use_virtual_time, workers);
+  if (schedule_mode == SCHEDULE_RECORD)
+    failed = schedule_write(schedule_path);
+  if (schedule_mode == SCHEDULE_REPLAY)
+    print_replay_summary();
 
-  return 0;
-}
\ No newline at end of file
+  if (print_stats)
+  {
+    print_report();
+    /* the comparisons play the scenario again, which a stream cannot */
+    if (config.lookahead > 0 && !streaming)
+      print_planner_report(generate ? NULL : args[optind], workers);
+    if (config.early_breaks && !streaming)
+      print_breaks_report(generate ? NULL : args[optind], workers);
+  }
+
+  runways_destroy();
+  lifecycle_destroy();
+  aircraft_arena_destroy();
+  schedule_close();
+  return failed;
+}
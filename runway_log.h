@@ -0,0 +1,102 @@
+/* Format of the binary event log written by `runway --binary-log=FILE`
+ * and read by runway-verify.
+ *
+ * The file is a log_header followed by log_record structs in the order
+ * the events were logged (seq counts up from 0 without gaps).  Records
+ * are in the byte order of the machine that wrote them.
+ */
+
+#ifndef RUNWAY_LOG_H
+#define RUNWAY_LOG_H
+
+/* Events that are also printed as text, see log_format() in runway.c */
+#define LOG_CONTROLLER_ARRIVED 0
+#define LOG_BREAK              1   /* occupancy: the runway when the break starts */
+#define LOG_SWITCHING          2   /* direction: the current one; occupancy as well */
+#define LOG_SWITCHED           3   /* direction: the new one; occupancy as well */
+#define LOG_FUEL_OUT           4
+#define LOG_ON_RUNWAY          5   /* value: fuel reserve in ms */
+#define LOG_BEGIN              6   /* value: runway time in ms */
+#define LOG_COMPLETE           7
+#define LOG_CLEARED            8
+
+/* Trace events, only written to the binary log.  Their occupancy is the
+ * runway state word right after the compare-and-swap that made the change,
+ * so every state the runway has been in appears in the log exactly.
+ */
+#define LOG_ENQUEUE            16  /* aircraft joins the wait queue of runway */
+#define LOG_GRANT              17  /* controller puts aircraft on runway */
+#define LOG_RELEASE            18  /* aircraft leaves runway */
+#define LOG_BREAK_END          19  /* controller is back from its break */
+
+/* Reports of runway --watchdog, printed as text as well.  Times and
+ * waits in value and extra are in ms.
+ */
+#define LOG_WATCHDOG           32  /* snapshot starts; value: the stall threshold in
+                                      seconds, 0 if asked for by SIGUSR1;
+                                      aircraft_id: aircraft cleared so far */
+#define LOG_WATCH_ARRIVALS     33  /* value: aircraft in flight; aircraft_id: of them
+                                      released but not queued; extra: WATCH_* */
+#define LOG_WATCH_RUNWAY       34  /* direction and occupancy; value: aircraft in a row
+                                      in the direction; extra: since the last break */
+#define LOG_WATCH_CONTROLLER   35  /* value: events pending; extra: WATCH_* */
+#define LOG_WATCH_DECISION     36  /* controller's last decision about aircraft_id (-1
+                                      if none); value: its time; extra: SCHED_*, or -1
+                                      if it has not decided anything yet */
+#define LOG_WATCH_QUEUE        37  /* value: aircraft waiting */
+#define LOG_WATCH_WAITING      38  /* one of the longest waiting aircraft; value: its
+                                      wait so far; extra: its fuel deadline, -1 for
+                                      an emergency aircraft */
+#define LOG_WATCH_END          39  /* snapshot ends */
+#define LOG_WATCH_STARVING     40  /* aircraft has waited longer than the emergency
+                                      timeout; value: its wait, counted from queueing
+                                      for an emergency aircraft and from running out
+                                      of fuel otherwise */
+
+/* extra of LOG_WATCH_ARRIVALS: what the arrival loop waits for */
+#define WATCH_ARRIVING         0   /* the next arrival time */
+#define WATCH_BACKLOG          1   /* the wait queues to drop below the backlog */
+#define WATCH_STREAM           2   /* the stream's next line */
+
+/* extra of LOG_WATCH_CONTROLLER */
+#define WATCH_EVALUATING       0
+#define WATCH_IDLE             1   /* waits on controller_cond */
+#define WATCH_PAUSED           2   /* on a break or switching direction */
+
+#define LOG_TRACE_ONLY(event) ((event) >= LOG_ENQUEUE && (event) < LOG_WATCHDOG)
+
+typedef struct
+{
+  unsigned long long seq;   /* order in which the events were logged */
+  long long time;           /* simulation time in ns when it was logged */
+  short event;              /* LOG_* */
+  short runway;             /* runway id, -1 if none */
+  int aircraft_id;          /* -1 if none */
+  short aircraft_type;      /* COMMERCIAL, CARGO, EMERGENCY or -1 */
+  short direction;          /* NORTH, SOUTH or -1 */
+  int value;
+  unsigned char total;      /* runway occupancy, for the events marked above */
+  unsigned char commercial;
+  unsigned char cargo;
+  unsigned char emergency;
+  int extra;                /* second value of the watchdog events */
+} log_record;
+
+/* The simulator's limits are recorded so the verifier checks a log
+ * against the rules it was produced under.
+ */
+typedef struct
+{
+  char magic[8];            /* LOG_MAGIC, zero padded */
+  int version;              /* LOG_VERSION */
+  int record_size;          /* sizeof(log_record) */
+  int runway_count;
+  int max_runway_capacity;
+  int controller_limit;
+  int emergency_timeout;    /* seconds */
+} log_header;
+
+#define LOG_MAGIC   "RWYLOG"
+#define LOG_VERSION 4
+
+#endif
@@ -0,0 +1,47 @@
+/* Binary scenario format, read by runway in place of a text input file
+ * and written by `runway --write-scenario=FILE`.
+ *
+ * The file is a scenario_header followed by count scenario_record
+ * structs, one per aircraft in arrival order.  runway maps the file and
+ * reads the records where they are, so loading costs nothing beyond the
+ * page faults.  Records are in the byte order of the machine that wrote
+ * them.
+ */
+
+#ifndef RUNWAY_SCENARIO_H
+#define RUNWAY_SCENARIO_H
+
+typedef struct
+{
+  int aircraft_type;        /* COMMERCIAL, CARGO or EMERGENCY */
+  int reserved;
+  long long arrival_time;   /* ns after the previous aircraft */
+  long long runway_time;    /* ns */
+  long long fuel_reserve;   /* ns, or SCENARIO_RANDOM_FUEL */
+} scenario_record;
+
+/* Records of version 1 files, in whole seconds.  runway still reads them. */
+typedef struct
+{
+  int aircraft_type;
+  int arrival_time;         /* seconds after the previous aircraft */
+  int runway_time;          /* seconds */
+  int fuel_reserve;         /* seconds, or SCENARIO_RANDOM_FUEL */
+} scenario_record_v1;
+
+/* The fuel reserve is drawn from the seeded generator, as for text files */
+#define SCENARIO_RANDOM_FUEL -1
+
+typedef struct
+{
+  char magic[8];            /* SCENARIO_MAGIC, zero padded */
+  int version;              /* SCENARIO_VERSION */
+  int record_size;          /* sizeof(scenario_record) of the version */
+  long long count;          /* number of records */
+} scenario_header;
+
+#define SCENARIO_MAGIC   "RWYSCN"
+#define SCENARIO_VERSION    2
+#define SCENARIO_VERSION_V1 1
+
+#endif
@@ -0,0 +1,55 @@
+/* Schedule of controller decisions, written by `runway --record=FILE` and
+ * played back by `runway --replay=FILE`.
+ *
+ * The file is a schedule_header followed by count schedule_record
+ * structs: the decisions of runway 0 in the order its controller made
+ * them, then those of runway 1 and so on.  Each aircraft's choice of
+ * runway is recorded with the runway it queued at.  When runways steal an
+ * aircraft from each other, their decisions about it are ordered by step.
+ * Records are in the byte order of the machine that wrote them.
+ */
+
+#ifndef RUNWAY_SCHEDULE_H
+#define RUNWAY_SCHEDULE_H
+
+#define SCHED_QUEUE        0   /* aircraft queues at runway on arrival */
+#define SCHED_STEAL        1   /* runway takes aircraft from another runway's queue */
+#define SCHED_GRANT        2   /* runway is granted to aircraft */
+#define SCHED_BREAK        3   /* break, due after controller-limit aircraft */
+#define SCHED_IDLE_BREAK   4   /* early break in an idle gap */
+#define SCHED_SWITCH       5   /* direction switch */
+#define SCHED_SWITCH_BREAK 6   /* direction switch with an early break */
+
+typedef struct
+{
+  long long time;           /* simulation time in ns of the decision */
+  int aircraft_id;          /* -1 for breaks and switches */
+  int step;                 /* records about this aircraft before this one */
+  short runway;
+  short decision;           /* SCHED_* */
+  int reserved;
+} schedule_record;
+
+#define SCHEDULE_PARAMS 16  /* room for the --set parameters */
+
+/* Everything else a run depends on, so a replay runs under the same
+ * rules as the recording.
+ */
+typedef struct
+{
+  char magic[8];            /* SCHEDULE_MAGIC, zero padded */
+  int version;              /* SCHEDULE_VERSION */
+  int record_size;          /* sizeof(schedule_record) */
+  unsigned long long seed;  /* --seed */
+  int runway_count;
+  int params;               /* number of values used in param_values */
+  int param_values[SCHEDULE_PARAMS];   /* --set parameters in runway's order */
+  char policy[16];          /* --policy, zero padded */
+  long long aircraft;       /* aircraft in the scenario */
+  long long count;          /* number of records */
+} schedule_header;
+
+#define SCHEDULE_MAGIC   "RWYSCHD"
+#define SCHEDULE_VERSION 1
+
+#endif
@@ -0,0 +1,60 @@
+/* Layout of the live statistics segment published by
+ * `runway --live-stats[=NAME]` and read by runway-top.
+ *
+ * The segment is a POSIX shared-memory object (shm_open(), default name
+ * LIVE_DEFAULT_NAME) holding a live_header followed by runway_count
+ * live_runway structs.  Every part has a single writer: the header is
+ * written by the arrival loop, each live_runway by its runway's
+ * controller.  They are seqlocks: the writer makes seq odd, writes, and
+ * makes it even again, and a reader copies the part and retries until it
+ * saw the same even seq before and after the copy.
+ */
+
+#ifndef RUNWAY_STATS_H
+#define RUNWAY_STATS_H
+
+#define LIVE_WAITS 256      /* waits kept per runway for the percentiles */
+
+typedef struct
+{
+  unsigned long long seq;   /* seqlock, odd while the runway is written */
+  int on_runway;            /* aircraft on the runway */
+  int on_runway_type[3];    /* of them COMMERCIAL, CARGO, EMERGENCY */
+  int waiting[3];           /* queued aircraft of each type */
+  int direction;            /* NORTH or SOUTH */
+  int consecutive;          /* aircraft in a row in this direction */
+  int since_break;          /* aircraft since the controller's last break */
+  int blocked;              /* on a break or switching direction */
+  int wait_count;           /* valid entries of recent_waits */
+  int reserved;
+  long long landings;       /* grants so far */
+  long long fuel_emergencies;
+  long long breaks;
+  long long switches;
+  int recent_waits[LIVE_WAITS]; /* ms from queueing to grant of the last
+                                   wait_count grants, a ring */
+} live_runway;
+
+typedef struct
+{
+  char magic[8];            /* LIVE_MAGIC, zero padded */
+  int version;              /* LIVE_VERSION */
+  int runway_size;          /* sizeof(live_runway) */
+  int runway_count;
+  int pid;                  /* of the simulator */
+  int virtual_time;         /* the simulation runs on the virtual clock */
+  int reserved;
+  unsigned long long seq;   /* seqlock of the fields below */
+  long long time;           /* simulation time in ns of the last arrival,
+                               or the end of the simulation once done */
+  long long aircraft;       /* aircraft in the scenario, 0 for a stream */
+  long long arrived;        /* aircraft released so far */
+  int done;                 /* the simulation has finished */
+  int reserved2;
+} live_header;
+
+#define LIVE_MAGIC        "RWYLIVE"
+#define LIVE_VERSION      1
+#define LIVE_DEFAULT_NAME "/runway-stats"
+
+#endif
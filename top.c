@@ -0,0 +1,279 @@
+/* runway-top: live view of a running simulation.
+ *
+ * Maps the statistics segment that `runway --live-stats[=NAME]` publishes
+ * (see runway_stats.h) read-only and redraws a table of every runway at
+ * a fixed interval:
+ *
+ *   dir       runway direction and aircraft landed in a row in it
+ *   brk       aircraft since the controller's last break
+ *   on        aircraft on the runway, commercial/cargo/emergency
+ *   waiting   aircraft queued, commercial/cargo/emergency
+ *   grants/s  grants per simulated second since the last refresh
+ *   fuel-out  aircraft that ran out of reserve fuel so far
+ *   wait      p50/p90/p99 of the waits of the latest grants, in seconds
+ *
+ * The simulator never waits for runway-top: each part of the segment is
+ * a seqlock and the copy is simply taken again if it changed meanwhile.
+ *
+ * Usage: runway-top [--interval=MS] [--once] [NAME]
+ * Exits when the simulation is done, or straight after the first table
+ * with --once.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "runway_stats.h"
+
+/* Values used in the segment, as in runway.c */
+#define COMMERCIAL 0
+#define CARGO 1
+#define EMERGENCY 2
+#define NORTH 0
+
+#define NSEC_PER_SEC 1000000000LL
+#define TOP_INTERVAL 1000           /* default refresh in ms */
+
+/* Copy size bytes from src, guarded by the seqlock *seq, to dst. */
+static void live_read(void *dst, const void *src, size_t size, const unsigned long long *seq)
+{
+  unsigned long long before, after;
+
+  do
+  {
+    while ((before = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1)
+      sched_yield();
+    memcpy(dst, src, size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+  } while (before != after);
+}
+
+static int wait_compare(const void *a, const void *b)
+{
+  int x = *(const int *)a, y = *(const int *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* The p'th percentile of the n sorted waits in ms, in seconds. */
+static double wait_percentile(const int *waits, int n, double p)
+{
+  int k;
+
+  if (n == 0)
+    return 0.0;
+  k = (int)(p * (n - 1) + 0.5);
+  return waits[k] / 1000.0;
+}
+
+static void print_waits(int *waits, int n)
+{
+  qsort(waits, n, sizeof(int), wait_compare);
+  if (n == 0)
+    printf("  %6s %6s %6s\n", "-", "-", "-");
+  else
+    printf("  %6.1f %6.1f %6.1f\n", wait_percentile(waits, n, 0.50),
+           wait_percentile(waits, n, 0.90), wait_percentile(waits, n, 0.99));
+}
+
+/* Print one table.  prev holds the runways as of the last table, taken
+ * at simulation time *prev_time, and is updated, for the grant rates.
+ */
+static void print_table(const char *name, const live_header *h, const live_runway *runways,
+                        live_runway *prev, long long *prev_time, int *all_waits)
+{
+  live_runway total;
+  double rate, total_rate = 0.0;
+  int all = 0;
+  int i, k;
+
+  memset(&total, 0, sizeof(total));
+  printf("runway-top  %s  pid %d  %.1f s%s  arrived %lld",
+         name, h->pid, (double)h->time / NSEC_PER_SEC, h->virtual_time ? " (virtual)" : "", h->arrived);
+  if (h->aircraft > 0)
+    printf("/%lld", h->aircraft);
+  printf("  %s\n\n", h->done ? "done" : "running");
+  printf("%-6s %-9s %4s %-6s %-12s %-12s %9s %8s %8s  %6s %6s %6s\n",
+         "runway", "dir", "brk", "state", "on C/G/E", "waiting C/G/E",
+         "landings", "grants/s", "fuel-out", "p50", "p90", "p99");
+  for (i = 0; i < h->runway_count; i++)
+  {
+    const live_runway *lr = &runways[i];
+    char dir[16], on[16], waiting[16];
+
+    if (h->time > *prev_time)
+      rate = (double)(lr->landings - prev[i].landings) * NSEC_PER_SEC / (h->time - *prev_time);
+    else
+      rate = 0.0;
+    total_rate += rate;
+    snprintf(dir, sizeof(dir), "%s %d", lr->direction == NORTH ? "NORTH" : "SOUTH", lr->consecutive);
+    snprintf(on, sizeof(on), "%d %d/%d/%d", lr->on_runway, lr->on_runway_type[COMMERCIAL],
+             lr->on_runway_type[CARGO], lr->on_runway_type[EMERGENCY]);
+    snprintf(waiting, sizeof(waiting), "%d %d/%d/%d",
+             lr->waiting[COMMERCIAL] + lr->waiting[CARGO] + lr->waiting[EMERGENCY],
+             lr->waiting[COMMERCIAL], lr->waiting[CARGO], lr->waiting[EMERGENCY]);
+    printf("%-6d %-9s %4d %-6s %-12s %-12s %9lld %8.2f %8lld",
+           i, dir, lr->since_break, lr->blocked ? "paused" : "-", on, waiting,
+           lr->landings, rate, lr->fuel_emergencies);
+    memcpy(all_waits + all, lr->recent_waits, lr->wait_count * sizeof(int));
+    print_waits(all_waits + all, lr->wait_count);
+    all += lr->wait_count;
+
+    total.on_runway += lr->on_runway;
+    for (k = 0; k < 3; k++)
+      total.waiting[k] += lr->waiting[k];
+    total.landings += lr->landings;
+    total.fuel_emergencies += lr->fuel_emergencies;
+    prev[i] = *lr;
+  }
+  if (h->runway_count > 1)
+  {
+    char on[16], waiting[16];
+
+    snprintf(on, sizeof(on), "%d", total.on_runway);
+    snprintf(waiting, sizeof(waiting), "%d %d/%d/%d",
+             total.waiting[COMMERCIAL] + total.waiting[CARGO] + total.waiting[EMERGENCY],
+             total.waiting[COMMERCIAL], total.waiting[CARGO], total.waiting[EMERGENCY]);
+    printf("%-6s %-9s %4s %-6s %-12s %-12s %9lld %8.2f %8lld",
+           "all", "", "", "", on, waiting, total.landings, total_rate, total.fuel_emergencies);
+    print_waits(all_waits, all);
+  }
+  if (h->time > *prev_time)
+    *prev_time = h->time;
+  fflush(stdout);
+}
+
+int main(int nargs, char **args)
+{
+  const char *name = LIVE_DEFAULT_NAME;
+  long interval = TOP_INTERVAL;
+  int once = 0;
+  const live_header *map;
+  live_header h;
+  live_runway *runways, *prev;
+  long long prev_time = 0;
+  int *all_waits;
+  struct timespec pause;
+  struct stat st;
+  char *end;
+  int fd;
+  int opt;
+  int i;
+  static const struct option long_options[] =
+  {
+    { "interval", required_argument, NULL, 'i' },
+    { "once",     no_argument,       NULL, 'o' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  while ((opt = getopt_long(nargs, args, "", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 'i':
+        errno = 0;
+        interval = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || errno != 0 || interval <= 0)
+        {
+          printf("runway-top: --interval needs a positive number of ms\n");
+          return 1;
+        }
+        break;
+      case 'o':
+        once = 1;
+        break;
+      default:
+        printf("Usage: runway-top [--interval=MS] [--once] [NAME]\n");
+        return 1;
+    }
+  }
+  if (nargs - optind > 1)
+  {
+    printf("Usage: runway-top [--interval=MS] [--once] [NAME]\n");
+    return 1;
+  }
+  if (optind < nargs)
+    name = args[optind];
+  pause.tv_sec = interval / 1000;
+  pause.tv_nsec = interval % 1000 * 1000000;
+
+  /* wait for the simulator to set the segment up */
+  while ((fd = shm_open(name, O_RDONLY, 0)) < 0 || fstat(fd, &st) != 0
+         || (size_t)st.st_size < sizeof(live_header))
+  {
+    if (fd >= 0)
+      close(fd);
+    if (once)
+    {
+      printf("runway-top: no simulation publishes %s (runway --live-stats)\n", name);
+      return 1;
+    }
+    nanosleep(&pause, NULL);
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    printf("runway-top: mmap failed: %s\n", strerror(errno));
+    return 1;
+  }
+  while (memcmp(map->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC)) != 0)
+    nanosleep(&pause, NULL);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (map->version != LIVE_VERSION || map->runway_size != sizeof(live_runway) || map->runway_count <= 0
+      || sizeof(live_header) + (size_t)map->runway_count * sizeof(live_runway) > (size_t)st.st_size)
+  {
+    printf("runway-top: %s is not a version %d statistics segment\n", name, LIVE_VERSION);
+    return 1;
+  }
+
+  runways = calloc(map->runway_count, sizeof(*runways));
+  prev = calloc(map->runway_count, sizeof(*prev));
+  all_waits = calloc((size_t)map->runway_count * LIVE_WAITS, sizeof(int));
+  if (runways == NULL || prev == NULL || all_waits == NULL)
+  {
+    printf("runway-top: out of memory\n");
+    return 1;
+  }
+
+  while (1)
+  {
+    live_read(&h, map, sizeof(h), &map->seq);
+    for (i = 0; i < h.runway_count; i++)
+    {
+      const live_runway *lr = (const live_runway *)(map + 1) + i;
+
+      live_read(&runways[i], lr, sizeof(*lr), &lr->seq);
+    }
+    if (!once)
+      printf("\033[H\033[2J");
+    print_table(name, &h, runways, prev, &prev_time, all_waits);
+    if (once || h.done)
+      break;
+    if (kill(h.pid, 0) != 0 && errno == ESRCH)
+    {
+      printf("\nrunway-top: the simulator (pid %d) has gone away\n", h.pid);
+      break;
+    }
+    nanosleep(&pause, NULL);
+  }
+
+  free(runways);
+  free(prev);
+  free(all_waits);
+  munmap((void *)map, st.st_size);
+  return 0;
+}
@@ -0,0 +1,353 @@
+/* runway-verify: offline check of a binary event log.
+ *
+ * Reads a log written with `runway --binary-log=FILE` (see runway_log.h)
+ * through mmap() and replays it in one linear pass, checking the rules of
+ * the simulation against every runway state that occurred:
+ *
+ *   capacity    no more than capacity aircraft on a runway
+ *   separation  commercial and cargo aircraft never share a runway
+ *   direction   commercial land NORTH, cargo SOUTH, and nobody lands
+ *               against the direction the runway was switched to
+ *   switch      the direction only changes while the runway is empty and
+ *               nobody is granted the runway during a switch
+ *   breaks      at most controller-limit grants between breaks, breaks
+ *               only on an empty runway and no grants during a break
+ *   timeout     emergency aircraft are granted a runway within
+ *               emergency-timeout seconds of queueing
+ *   lifecycle   every aircraft is queued, granted and released once
+ *
+ * The limits come from the log header, so a log is checked against the
+ * parameters (--set) of the run that wrote it.  With the verifier catching violations after the
+ * fact, the simulator itself can be built without its assert()s
+ * (make ASSERT_FLAGS=-DNDEBUG).
+ *
+ * Usage: runway-verify <log file>
+ * Exits with 0 if the log is clean, 1 if a rule was broken.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "runway_log.h"
+
+/* Values used in the log, as in runway.c */
+#define COMMERCIAL 0
+#define CARGO 1
+#define EMERGENCY 2
+#define NORTH 0
+#define SOUTH 1
+
+#define NSEC_PER_SEC 1000000000LL
+#define VERIFY_SHOW 10            /* violations printed in full per check */
+
+#define CHECK_LOG        0
+#define CHECK_CAPACITY   1
+#define CHECK_SEPARATION 2
+#define CHECK_DIRECTION  3
+#define CHECK_SWITCH     4
+#define CHECK_BREAKS     5
+#define CHECK_TIMEOUT    6
+#define CHECK_LIFECYCLE  7
+#define CHECKS           8
+
+static const char *check_names[CHECKS] =
+{
+  "log order", "capacity", "separation", "direction",
+  "switch", "breaks", "emergency timeout", "lifecycle"
+};
+
+static long violations[CHECKS];
+
+typedef struct
+{
+  int direction;                /* as last switched to */
+  int switching;                /* between LOG_SWITCHING and LOG_SWITCHED */
+  int on_break;                 /* between LOG_BREAK and LOG_BREAK_END */
+  int since_break;              /* grants since the last break */
+} runway_track;
+
+#define AIRCRAFT_UNSEEN   0
+#define AIRCRAFT_QUEUED   1
+#define AIRCRAFT_GRANTED  2
+#define AIRCRAFT_RELEASED 3
+
+typedef struct
+{
+  int state;                    /* AIRCRAFT_* above */
+  long long enqueued;           /* time of LOG_ENQUEUE */
+} aircraft_track;
+
+static aircraft_track *aircraft = NULL;
+static int aircraft_capacity = 0;
+static int aircraft_count = 0;  /* highest aircraft id seen + 1 */
+
+static void violation(int check, const log_record *rec, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (++violations[check] > VERIFY_SHOW)
+    return;
+  printf("%-18s seq %llu, t=%.3fs, runway %d: ", check_names[check],
+         rec->seq, (double)rec->time / NSEC_PER_SEC, rec->runway);
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  printf("\n");
+}
+
+/* Tracking record of aircraft id, growing the table as needed. */
+static aircraft_track *aircraft_get(int id)
+{
+  if (id >= aircraft_capacity)
+  {
+    int capacity = aircraft_capacity ? aircraft_capacity : 1024;
+    aircraft_track *table;
+
+    while (capacity <= id)
+      capacity *= 2;
+    table = realloc(aircraft, capacity * sizeof(*table));
+    if (table == NULL)
+    {
+      printf("runway-verify: out of memory\n");
+      exit(1);
+    }
+    memset(table + aircraft_capacity, 0, (capacity - aircraft_capacity) * sizeof(*table));
+    aircraft = table;
+    aircraft_capacity = capacity;
+  }
+  if (id >= aircraft_count)
+    aircraft_count = id + 1;
+  return &aircraft[id];
+}
+
+/* Capacity and separation hold in every recorded runway state. */
+static void check_occupancy(const log_header *h, const log_record *rec)
+{
+  if (rec->total > h->max_runway_capacity
+      || rec->total != rec->commercial + rec->cargo + rec->emergency)
+    violation(CHECK_CAPACITY, rec, "%d aircraft on the runway (%d commercial, %d cargo, "
+              "%d emergency)", rec->total, rec->commercial, rec->cargo, rec->emergency);
+  if (rec->commercial > 0 && rec->cargo > 0)
+    violation(CHECK_SEPARATION, rec, "%d commercial and %d cargo aircraft share the runway",
+              rec->commercial, rec->cargo);
+}
+
+static void replay_grant(const log_header *h, runway_track *rt, const log_record *rec)
+{
+  aircraft_track *at = aircraft_get(rec->aircraft_id);
+
+  if (at->state != AIRCRAFT_QUEUED)
+    violation(CHECK_LIFECYCLE, rec, "aircraft %d granted without waiting in a queue",
+              rec->aircraft_id);
+  at->state = AIRCRAFT_GRANTED;
+
+  if ((rec->aircraft_type == COMMERCIAL && rec->direction != NORTH)
+      || (rec->aircraft_type == CARGO && rec->direction != SOUTH))
+    violation(CHECK_DIRECTION, rec, "%s aircraft %d lands %s",
+              rec->aircraft_type == COMMERCIAL ? "commercial" : "cargo", rec->aircraft_id,
+              rec->direction == NORTH ? "NORTH" : "SOUTH");
+  if (rec->direction != rt->direction)
+    violation(CHECK_DIRECTION, rec, "aircraft %d lands %s on a runway switched to %s",
+              rec->aircraft_id, rec->direction == NORTH ? "NORTH" : "SOUTH",
+              rt->direction == NORTH ? "NORTH" : "SOUTH");
+
+  if (rt->switching)
+    violation(CHECK_SWITCH, rec, "aircraft %d granted during a direction switch",
+              rec->aircraft_id);
+  if (rt->on_break)
+    violation(CHECK_BREAKS, rec, "aircraft %d granted while the controller is on a break",
+              rec->aircraft_id);
+  if (++rt->since_break > h->controller_limit)
+    violation(CHECK_BREAKS, rec, "grant %d since the last break (limit %d)",
+              rt->since_break, h->controller_limit);
+
+  if (rec->aircraft_type == EMERGENCY
+      && rec->time - at->enqueued > (long long)h->emergency_timeout * NSEC_PER_SEC)
+    violation(CHECK_TIMEOUT, rec, "emergency aircraft %d waited %.3fs (limit %ds)",
+              rec->aircraft_id, (double)(rec->time - at->enqueued) / NSEC_PER_SEC,
+              h->emergency_timeout);
+}
+
+/* Replay one record against the state built up so far. */
+static void replay(const log_header *h, runway_track *runways, const log_record *rec)
+{
+  runway_track *rt;
+  aircraft_track *at;
+
+  /* watchdog reports check nothing */
+  if (rec->event >= LOG_WATCHDOG)
+    return;
+  rt = &runways[rec->runway];
+  if (LOG_TRACE_ONLY(rec->event) || rec->event == LOG_BREAK
+      || rec->event == LOG_SWITCHING || rec->event == LOG_SWITCHED)
+    check_occupancy(h, rec);
+
+  switch (rec->event)
+  {
+    case LOG_ENQUEUE:
+      at = aircraft_get(rec->aircraft_id);
+      if (at->state != AIRCRAFT_UNSEEN)
+        violation(CHECK_LIFECYCLE, rec, "aircraft %d queued twice", rec->aircraft_id);
+      at->state = AIRCRAFT_QUEUED;
+      at->enqueued = rec->time;
+      break;
+    case LOG_GRANT:
+      replay_grant(h, rt, rec);
+      break;
+    case LOG_RELEASE:
+      at = aircraft_get(rec->aircraft_id);
+      if (at->state != AIRCRAFT_GRANTED)
+        violation(CHECK_LIFECYCLE, rec, "aircraft %d leaves a runway it was not granted",
+                  rec->aircraft_id);
+      at->state = AIRCRAFT_RELEASED;
+      break;
+    case LOG_BREAK:
+      if (rec->total > 0)
+        violation(CHECK_BREAKS, rec, "break with %d aircraft on the runway", rec->total);
+      rt->on_break = 1;
+      rt->since_break = 0;
+      break;
+    case LOG_BREAK_END:
+      rt->on_break = 0;
+      break;
+    case LOG_SWITCHING:
+      if (rec->total > 0)
+        violation(CHECK_SWITCH, rec, "direction switch with %d aircraft on the runway",
+                  rec->total);
+      rt->switching = 1;
+      break;
+    case LOG_SWITCHED:
+      if (rec->total > 0)
+        violation(CHECK_SWITCH, rec, "direction switched with %d aircraft on the runway",
+                  rec->total);
+      rt->switching = 0;
+      rt->direction = rec->direction;
+      break;
+  }
+}
+
+int main(int nargs, char **args)
+{
+  const log_header *h;
+  const log_record *records;
+  runway_track *runways;
+  struct stat st;
+  long count, i;
+  long total = 0;
+  void *map;
+  int fd;
+  int k;
+
+  if (nargs != 2)
+  {
+    printf("Usage: runway-verify <log file>\n");
+    return EINVAL;
+  }
+
+  if ((fd = open(args[1], O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+  {
+    printf("Cannot open log file %s for reading.\n", args[1]);
+    return 1;
+  }
+  if ((size_t)st.st_size < sizeof(log_header))
+  {
+    printf("runway-verify: %s is too short for a runway log\n", args[1]);
+    return 1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    printf("runway-verify: mmap failed: %s\n", strerror(errno));
+    return 1;
+  }
+  close(fd);
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  h = (const log_header *)map;
+  if (memcmp(h->magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || h->version != LOG_VERSION
+      || h->record_size != sizeof(log_record) || h->runway_count <= 0)
+  {
+    printf("runway-verify: %s is not a version %d runway log\n", args[1], LOG_VERSION);
+    return 1;
+  }
+  if ((st.st_size - sizeof(log_header)) % sizeof(log_record) != 0)
+  {
+    printf("runway-verify: %s ends in the middle of a record\n", args[1]);
+    return 1;
+  }
+  records = (const log_record *)(h + 1);
+  count = (st.st_size - sizeof(log_header)) / sizeof(log_record);
+
+  runways = calloc(h->runway_count, sizeof(*runways));
+  if (runways == NULL)
+  {
+    printf("runway-verify: out of memory\n");
+    return 1;
+  }
+  for (k = 0; k < h->runway_count; k++)
+    runways[k].direction = NORTH;
+
+  for (i = 0; i < count; i++)
+  {
+    const log_record *rec = &records[i];
+
+    if (rec->seq != (unsigned long long)i)
+      violation(CHECK_LOG, rec, "record %ld is out of order", i);
+    if (rec->runway < 0 || rec->runway >= h->runway_count)
+    {
+      if (rec->runway >= h->runway_count)
+        violation(CHECK_LOG, rec, "no such runway");
+      continue;
+    }
+    if (rec->aircraft_id < -1)
+    {
+      violation(CHECK_LOG, rec, "bad aircraft id %d", rec->aircraft_id);
+      continue;
+    }
+    replay(h, runways, rec);
+  }
+
+  /* every aircraft in the log must have left its runway by the end */
+  for (i = 0; i < aircraft_count; i++)
+  {
+    if (aircraft[i].state == AIRCRAFT_QUEUED || aircraft[i].state == AIRCRAFT_GRANTED)
+    {
+      log_record end;
+
+      memset(&end, 0, sizeof(end));
+      end.seq = count;
+      end.time = count ? records[count - 1].time : 0;
+      end.runway = -1;
+      violation(CHECK_LIFECYCLE, &end, "aircraft %ld never left the %s", i,
+                aircraft[i].state == AIRCRAFT_QUEUED ? "wait queue" : "runway");
+    }
+  }
+
+  printf("%s: %ld records, %d aircraft, %d runway%s (capacity %d, break every %d, "
+         "emergency timeout %ds)\n", args[1], count, aircraft_count, h->runway_count,
+         h->runway_count > 1 ? "s" : "", h->max_runway_capacity, h->controller_limit,
+         h->emergency_timeout);
+  for (k = 0; k < CHECKS; k++)
+  {
+    if (violations[k] == 0)
+      printf("  %-18s ok\n", check_names[k]);
+    else
+      printf("  %-18s %ld violation%s\n", check_names[k], violations[k],
+             violations[k] > 1 ? "s" : "");
+    total += violations[k];
+  }
+
+  munmap(map, st.st_size);
+  free(runways);
+  free(aircraft);
+  return total ? 1 : 0;
+}